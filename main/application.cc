@@ -10,6 +10,11 @@
 #include "assets.h"
 #include "settings.h"
 #include "printer/thermal_printer.h"
+#include "boot_timeline.h"
+#include "startup_scheduler.h"
+#if CONFIG_USE_RUNTIME_PROFILER
+#include "runtime_profiler.h"
+#endif
 
 #include <cstring>
 #include <esp_log.h>
@@ -60,7 +65,14 @@ bool Application::SetDeviceState(DeviceState state) {
 }
 
 void Application::Initialize() {
+#if CONFIG_USE_RUNTIME_PROFILER
+    RuntimeProfiler::GetInstance().Start();
+#endif
+    auto& timeline = BootTimeline::GetInstance();
+    // Boards set up their display in the constructor
+    timeline.Begin("board");
     auto& board = Board::GetInstance();
+    timeline.End("board");
     SetDeviceState(kDeviceStateStarting);
 
     // Setup the display
@@ -69,36 +81,14 @@ void Application::Initialize() {
     // Print board name/version info
     display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
 
-    // Setup the audio service
-    auto codec = board.GetAudioCodec();
-    audio_service_.Initialize(codec);
-    audio_service_.Start();
-
-    AudioServiceCallbacks callbacks;
-    callbacks.on_send_queue_available = [this]() {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
-    };
-    callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
-    };
-    callbacks.on_vad_change = [this](bool speaking) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
-    };
-    audio_service_.SetCallbacks(callbacks);
-
     // Add state change listeners
     state_machine_.AddStateChangeListener([this](DeviceState old_state, DeviceState new_state) {
         OnStateChanged(old_state, new_state);
     });
 
-    // Start the clock timer to update the status bar
+    // Start the clock timer, it refreshes the status bar when the minute changes
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
 
-    // Add MCP common tools (only once during initialization)
-    auto& mcp_server = McpServer::GetInstance();
-    mcp_server.AddCommonTools();
-    mcp_server.AddUserOnlyTools();
-
     // Set network event callback for UI updates and network state handling
     board.SetNetworkEventCallback([this](NetworkEvent event, const std::string& data) {
         auto display = Board::GetInstance().GetDisplay();
@@ -157,14 +147,71 @@ void Application::Initialize() {
         }
     });
 
-    // Start network asynchronously
-    board.StartNetwork();
+    // Independent startup jobs run concurrently on both cores. Jobs are started in
+    // the order they are added, so the background jobs go first and overlap with
+    // the inline audio and network jobs below.
+    StartupScheduler startup;
+
+    // Mounting the assets partition validates it, which takes a while on large partitions
+    startup.Add("assets_mount", {}, []() {
+        Assets::GetInstance();
+    });
+
+    // Add MCP common tools (only once during initialization)
+    startup.Add("mcp_tools", {"assets_mount"}, [this]() {
+        auto& mcp_server = McpServer::GetInstance();
+        mcp_server.AddCommonTools();
+        mcp_server.AddUserOnlyTools();
+#if CONFIG_MCP_TOOL_CALL_BENCHMARK
+        mcp_server.RunToolCallBenchmark();
+#endif
+#if CONFIG_MCP_BATCH_SELF_CHECK
+        RunMcpBatchCheck();
+#endif
+    }, 4096 * 2);
+
+    // Audio runs in the main task before the network starts: WiFi config mode reads
+    // audio for acoustic provisioning and modem errors play alert sounds
+    startup.Add("audio", {}, [this, &board]() {
+        auto codec = board.GetAudioCodec();
+        audio_service_.Initialize(codec);
+        audio_service_.Start();
+
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [this]() {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+        };
+        callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
+        };
+        callbacks.on_vad_change = [this](bool speaking) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
+        };
+        audio_service_.SetCallbacks(callbacks);
+    }, 0, true);
+
+    startup.Add("network_start", {"audio"}, [&board]() {
+        // Start network asynchronously, network_connected marks when it is up
+        board.StartNetwork();
+    }, 0, true);
+
+    // Fonts, emoji and SR models only need the network when a new assets download is pending
+    startup.Add("assets_apply", {"assets_mount", "audio"}, [this]() {
+        auto& assets = Assets::GetInstance();
+        Settings settings("assets");
+        if (assets.partition_valid() && settings.GetString("download_url").empty()) {
+            assets_applied_ = assets.Apply();
+        }
+    }, 4096 * 2);
+
+    startup.Run();
 
     // Update the status bar immediately to show the network state
     display->UpdateStatusBar(true);
 }
 
 void Application::Run() {
+    main_task_handle_ = xTaskGetCurrentTaskHandle();
     const EventBits_t ALL_EVENTS = 
         MAIN_EVENT_SCHEDULE |
         MAIN_EVENT_SEND_AUDIO |
@@ -178,7 +225,8 @@ void Application::Run() {
         MAIN_EVENT_START_LISTENING |
         MAIN_EVENT_STOP_LISTENING |
         MAIN_EVENT_ACTIVATION_DONE |
-        MAIN_EVENT_STATE_CHANGED;
+        MAIN_EVENT_STATE_CHANGED |
+        MAIN_EVENT_STATUS_CHANGED;
 
     while (true) {
         auto bits = xEventGroupWaitBits(event_group_, ALL_EVENTS, pdTRUE, pdFALSE, portMAX_DELAY);
@@ -244,11 +292,25 @@ void Application::Run() {
             }
         }
 
-        if (bits & MAIN_EVENT_CLOCK_TICK) {
-            clock_ticks_++;
+        if (bits & MAIN_EVENT_STATUS_CHANGED) {
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
-        
+        }
+
+        if (bits & MAIN_EVENT_CLOCK_TICK) {
+            clock_ticks_++;
+
+            // Volume, ADC battery and network connection changes refresh the status bar when
+            // they happen. The signal level and the power managers have no change events, they
+            // are sampled every 10 seconds, and the clock is refreshed when the minute changes.
+            // UpdateStatusBar only touches the display when an icon has changed.
+            time_t minute = time(nullptr) / 60;
+            if (minute != status_bar_minute_ || clock_ticks_ % 10 == 0) {
+                status_bar_minute_ = minute;
+                auto display = Board::GetInstance().GetDisplay();
+                display->UpdateStatusBar(true);
+            }
+
             // Print debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 SystemInfo::PrintHeapStats();
@@ -259,6 +321,8 @@ void Application::Run() {
 
 void Application::HandleNetworkConnectedEvent() {
     ESP_LOGI(TAG, "Network connected");
+    BootTimeline::GetInstance().Mark("network_connected");
+    McpServer::GetInstance().InvalidateCache(kMcpCacheKeyNetwork);
     auto state = GetDeviceState();
 
     if (state == kDeviceStateStarting || state == kDeviceStateWifiConfiguring) {
@@ -283,6 +347,7 @@ void Application::HandleNetworkConnectedEvent() {
 }
 
 void Application::HandleNetworkDisconnectedEvent() {
+    McpServer::GetInstance().InvalidateCache(kMcpCacheKeyNetwork);
     // Close current conversation when network disconnected
     auto state = GetDeviceState();
     if (state == kDeviceStateConnecting || state == kDeviceStateListening || state == kDeviceStateSpeaking) {
@@ -298,6 +363,9 @@ void Application::HandleNetworkDisconnectedEvent() {
 void Application::HandleActivationDoneEvent() {
     ESP_LOGI(TAG, "Activation done");
 
+    auto& timeline = BootTimeline::GetInstance();
+    timeline.Mark("ready");
+    timeline.PrintWaterfall();
     SystemInfo::PrintHeapStats();
     SetDeviceState(kDeviceStateIdle);
 
@@ -319,17 +387,38 @@ void Application::HandleActivationDoneEvent() {
 }
 
 void Application::ActivationTask() {
+    auto& timeline = BootTimeline::GetInstance();
     // Create OTA object for activation process
     ota_ = std::make_unique<Ota>();
 
     // Check for new assets version
+    timeline.Begin("assets_check");
     CheckAssetsVersion();
+    timeline.End("assets_check");
+
+#if CONFIG_USE_CACHED_VERSION_CHECK
+    // Connect with the config from the last version check and refresh it afterwards
+    if (ota_->LoadCachedResponse()) {
+        ESP_LOGI(TAG, "Starting the protocol from the cached version check");
+        timeline.Begin("protocol_init");
+        InitializeProtocol();
+        timeline.End("protocol_init");
+        xEventGroupSetBits(event_group_, MAIN_EVENT_ACTIVATION_DONE);
+
+        RefreshVersionCheck();
+        return;
+    }
+#endif
 
     // Check for new firmware version
+    timeline.Begin("version_check");
     CheckNewVersion();
+    timeline.End("version_check");
 
     // Initialize the protocol
+    timeline.Begin("protocol_init");
     InitializeProtocol();
+    timeline.End("protocol_init");
 
     // Signal completion to main loop
     xEventGroupSetBits(event_group_, MAIN_EVENT_ACTIVATION_DONE);
@@ -356,8 +445,6 @@ void Application::CheckAssetsVersion() {
     std::string download_url = settings.GetString("download_url");
 
     if (!download_url.empty()) {
-        settings.EraseKey("download_url");
-
         char message[256];
         snprintf(message, sizeof(message), Lang::Strings::FOUND_NEW_ASSETS, download_url.c_str());
         Alert(Lang::Strings::LOADING_ASSETS, message, "cloud_arrow_down", Lang::Sounds::OGG_UPGRADE);
@@ -376,6 +463,8 @@ void Application::CheckAssetsVersion() {
             }).detach();
         });
 
+        // Kept until the download returns, so a power loss resumes it on the next boot
+        settings.EraseKey("download_url");
         board.SetPowerSaveLevel(PowerSaveLevel::LOW_POWER);
         vTaskDelay(pdMS_TO_TICKS(1000));
 
@@ -387,8 +476,10 @@ void Application::CheckAssetsVersion() {
         }
     }
 
-    // Apply assets
-    assets.Apply();
+    // Apply assets, unless the startup already did and nothing new was downloaded
+    if (!download_url.empty() || !assets_applied_) {
+        assets.Apply();
+    }
     display->SetChatMessage("system", "");
     display->SetEmotion("microchip_ai");
 }
@@ -431,7 +522,7 @@ void Application::CheckNewVersion() {
         retry_delay = 10; // Reset retry delay
 
         if (ota_->HasNewVersion()) {
-            if (UpgradeFirmware(ota_->GetFirmwareUrl(), ota_->GetFirmwareVersion())) {
+            if (UpgradeFirmware(ota_->GetFirmwareUrl(), ota_->GetFirmwareVersion(), ota_->GetFirmwareDeltaUrl())) {
                 return; // This line will never be reached after reboot
             }
             // If upgrade failed, continue to normal operation
@@ -468,6 +559,47 @@ void Application::CheckNewVersion() {
     }
 }
 
+#if CONFIG_USE_CACHED_VERSION_CHECK
+// Runs the version check in the background once the protocol is up, with its own Ota object
+// because ota_ is released when the activation is done
+void Application::RefreshVersionCheck() {
+    const int MAX_RETRY = 10;
+    int retry_delay = 10; // Initial retry delay in seconds
+
+    Ota ota;
+    for (int retry_count = 1; ota.CheckVersion() != ESP_OK; retry_count++) {
+        if (retry_count >= MAX_RETRY) {
+            ESP_LOGE(TAG, "Too many retries, exit version check");
+            return;
+        }
+        ESP_LOGW(TAG, "Check new version failed, retry in %d seconds (%d/%d)", retry_delay, retry_count, MAX_RETRY);
+        vTaskDelay(pdMS_TO_TICKS(retry_delay * 1000));
+        retry_delay *= 2; // Double the retry delay
+    }
+
+    if (ota.HasActivationCode() || ota.HasActivationChallenge()) {
+        // The cached response was dropped by the check, the next boot goes through the activation
+        ESP_LOGW(TAG, "The device needs to be activated again, rebooting");
+        Schedule([this]() {
+            Reboot();
+        });
+        return;
+    }
+
+    bool has_server_time = ota.HasServerTime();
+    if (ota.HasNewVersion()) {
+        Schedule([this, url = ota.GetFirmwareUrl(), version = ota.GetFirmwareVersion(), delta_url = ota.GetFirmwareDeltaUrl()]() {
+            UpgradeFirmware(url, version, delta_url);
+        });
+    } else {
+        ota.MarkCurrentVersionValid();
+    }
+    Schedule([this, has_server_time]() {
+        has_server_time_ = has_server_time;
+    });
+}
+#endif
+
 void Application::InitializeProtocol() {    
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
@@ -526,157 +658,211 @@ void Application::InitializeProtocol() {
         });
     });
     
+    protocol_->OnIncomingJson([this](const cJSON* root) {
+        HandleIncomingJson(root);
+    });
+    
+    protocol_->Start();
+}
+
+void Application::HandleIncomingJson(const cJSON* root) {
+    auto& board = Board::GetInstance();
+    auto display = board.GetDisplay();
     auto printer = board.GetThermalPrinter();
-    protocol_->OnIncomingJson([this, display, printer](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
-            if (auto json_str = cJSON_PrintUnformatted(root)) {
-                ESP_LOGW(TAG, "Incoming JSON missing string 'type': %s", json_str);
-                cJSON_free(json_str);
-            } else {
-                ESP_LOGW(TAG, "Incoming JSON missing string 'type'");
-            }
-            return;
-        }
 
-        ESP_LOGI(TAG, "Incoming JSON type: %s", type->valuestring);
+    // Parse JSON data
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type)) {
+        if (auto json_str = cJSON_PrintUnformatted(root)) {
+            ESP_LOGW(TAG, "Incoming JSON missing string 'type': %s", json_str);
+            cJSON_free(json_str);
+        } else {
+            ESP_LOGW(TAG, "Incoming JSON missing string 'type'");
+        }
+        return;
+    }
 
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
-                Schedule([this]() {
-                    aborted_ = false;
-                    SetDeviceState(kDeviceStateSpeaking);
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
-                    if (GetDeviceState() == kDeviceStateSpeaking) {
-                        if (listening_mode_ == kListeningModeManualStop) {
-                            SetDeviceState(kDeviceStateIdle);
-                        } else {
-                            SetDeviceState(kDeviceStateListening);
-                        }
+    ESP_LOGI(TAG, "Incoming JSON type: %s", type->valuestring);
+
+    if (strcmp(type->valuestring, "tts") == 0) {
+        auto state = cJSON_GetObjectItem(root, "state");
+        if (strcmp(state->valuestring, "start") == 0) {
+            Schedule([this, display]() {
+                aborted_ = false;
+                // The sentences of this reply go into a new message
+                display->EndChatStream();
+                SetDeviceState(kDeviceStateSpeaking);
+            });
+        } else if (strcmp(state->valuestring, "stop") == 0) {
+            Schedule([this]() {
+                if (GetDeviceState() == kDeviceStateSpeaking) {
+                    if (listening_mode_ == kListeningModeManualStop) {
+                        SetDeviceState(kDeviceStateIdle);
+                    } else {
+                        SetDeviceState(kDeviceStateListening);
                     }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([display, message = std::string(text->valuestring)]() {
-                        display->SetChatMessage("assistant", message.c_str());
-                    });
                 }
-            }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
+            });
+        } else if (strcmp(state->valuestring, "sentence_start") == 0) {
             auto text = cJSON_GetObjectItem(root, "text");
             if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, "STT text: %s", text->valuestring);
+                ESP_LOGI(TAG, "<< %s", text->valuestring);
                 Schedule([display, message = std::string(text->valuestring)]() {
-                    display->SetChatMessage("user", message.c_str());
+                    display->AppendChatMessage("assistant", message.c_str());
                 });
-                /*
-                if (printer != nullptr && printer->initialized()) {
-                    // Direct UART write keeps latency low; payload is small.
-                    esp_err_t err = printer->PrintText(text->valuestring);
-                    if (err != ESP_OK) {
-                        ESP_LOGE(TAG, "Printer write failed: %s", esp_err_to_name(err));
-                    } else {
-                        ESP_LOGI(TAG, "Printer wrote STT text");
-                    }
+            }
+        }
+    } else if (strcmp(type->valuestring, "stt") == 0) {
+        auto text = cJSON_GetObjectItem(root, "text");
+        if (cJSON_IsString(text)) {
+            ESP_LOGI(TAG, "STT text: %s", text->valuestring);
+            Schedule([display, message = std::string(text->valuestring)]() {
+                display->SetChatMessage("user", message.c_str());
+            });
+            /*
+            if (printer != nullptr && printer->initialized()) {
+                // Direct UART write keeps latency low; payload is small.
+                esp_err_t err = printer->PrintText(text->valuestring);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Printer write failed: %s", esp_err_to_name(err));
                 } else {
-                    ESP_LOGW(TAG, "Thermal printer unavailable or not initialized; skip printing STT text");
+                    ESP_LOGI(TAG, "Printer wrote STT text");
                 }
-                */
             } else {
-                ESP_LOGW(TAG, "STT message missing string 'text'");
+                ESP_LOGW(TAG, "Thermal printer unavailable or not initialized; skip printing STT text");
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
+            */
+        } else {
+            ESP_LOGW(TAG, "STT message missing string 'text'");
+        }
+    } else if (strcmp(type->valuestring, "llm") == 0) {
+        if (auto json_str = cJSON_PrintUnformatted(root)) {
+            ESP_LOGI(TAG, "Received LLM message: %s", json_str);
+            cJSON_free(json_str);
+        }
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(emotion)) {
+            Schedule([display, emotion_str = std::string(emotion->valuestring)]() {
+                display->SetEmotion(emotion_str.c_str());
+            });
+        }
+    } else if (strcmp(type->valuestring, "thinking") == 0) {
+        auto status = cJSON_GetObjectItem(root, "status");
+        if (cJSON_IsString(status)) {
             if (auto json_str = cJSON_PrintUnformatted(root)) {
-                ESP_LOGI(TAG, "Received LLM message: %s", json_str);
+                ESP_LOGI(TAG, "Received thinking message: %s", json_str);
                 cJSON_free(json_str);
             }
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([display, emotion_str = std::string(emotion->valuestring)]() {
-                    display->SetEmotion(emotion_str.c_str());
+            if (strcmp(status->valuestring, "start") == 0) {
+                Schedule([this]() {
+                    SetDeviceState(kDeviceStateThinking);
+                });
+            } else if (strcmp(status->valuestring, "stop") == 0) {
+                Schedule([this]() {
+                    SetDeviceState(kDeviceStateIdle);
                 });
             }
-        } else if (strcmp(type->valuestring, "thinking") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            if (cJSON_IsString(status)) {
-                if (auto json_str = cJSON_PrintUnformatted(root)) {
-                    ESP_LOGI(TAG, "Received thinking message: %s", json_str);
-                    cJSON_free(json_str);
-                }
-                if (strcmp(status->valuestring, "start") == 0) {
-                    Schedule([this]() {
-                        SetDeviceState(kDeviceStateThinking);
-                    });
-                } else if (strcmp(status->valuestring, "stop") == 0) {
-                    Schedule([this]() {
-                        SetDeviceState(kDeviceStateIdle);
-                    });
-                }
-            }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                char* payload_str = cJSON_PrintUnformatted(payload);
-                if (payload_str != nullptr) {
-                    ESP_LOGI(TAG, "Received MCP message: %s", payload_str);
-                    cJSON_free(payload_str);
-                } else {
-                    ESP_LOGI(TAG, "Received MCP message (payload print failed)");
-                }
-                McpServer::GetInstance().ParseMessage(payload);
-            }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
-                    // Do a reboot if user requests a OTA update
-                    Schedule([this]() {
-                        Reboot();
-                    });
-                } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-                }
-            }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+        }
+    } else if (strcmp(type->valuestring, "mcp") == 0) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        // A JSON-RPC batch arrives as an array and gets one combined reply
+        if (cJSON_IsObject(payload) || cJSON_IsArray(payload)) {
+            char* payload_str = cJSON_PrintUnformatted(payload);
+            if (payload_str != nullptr) {
+                ESP_LOGI(TAG, "Received MCP message: %s", payload_str);
+                cJSON_free(payload_str);
             } else {
-                ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+                ESP_LOGI(TAG, "Received MCP message (payload print failed)");
             }
-#if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
-            if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-                    display->SetChatMessage("system", payload_str.c_str());
+            McpServer::GetInstance().ParseMessage(payload);
+        }
+    } else if (strcmp(type->valuestring, "system") == 0) {
+        auto command = cJSON_GetObjectItem(root, "command");
+        if (cJSON_IsString(command)) {
+            ESP_LOGI(TAG, "System command: %s", command->valuestring);
+            if (strcmp(command->valuestring, "reboot") == 0) {
+                // Do a reboot if user requests a OTA update
+                Schedule([this]() {
+                    Reboot();
                 });
             } else {
-                ESP_LOGW(TAG, "Invalid custom message format: missing payload");
+                ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
             }
+        }
+    } else if (strcmp(type->valuestring, "alert") == 0) {
+        auto status = cJSON_GetObjectItem(root, "status");
+        auto message = cJSON_GetObjectItem(root, "message");
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
+            Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+        } else {
+            ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+        }
+#if CONFIG_RECEIVE_CUSTOM_MESSAGE
+    } else if (strcmp(type->valuestring, "custom") == 0) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
+        if (cJSON_IsObject(payload)) {
+            Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
+                display->SetChatMessage("system", payload_str.c_str());
+            });
+        } else {
+            ESP_LOGW(TAG, "Invalid custom message format: missing payload");
+        }
 #endif
+    } else {
+        if (auto json_str = cJSON_PrintUnformatted(root)) {
+            ESP_LOGW(TAG, "Unknown message type: %s | payload: %s", type->valuestring, json_str);
+            cJSON_free(json_str);
         } else {
-            if (auto json_str = cJSON_PrintUnformatted(root)) {
-                ESP_LOGW(TAG, "Unknown message type: %s | payload: %s", type->valuestring, json_str);
-                cJSON_free(json_str);
-            } else {
-                ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+        }
+    }
+}
+
+#if CONFIG_MCP_BATCH_SELF_CHECK
+/*
+ * Send a JSON-RPC batch through HandleIncomingJson the way the server does and check
+ * that a single reply goes out: an array with one response per request, in order,
+ * and none for the notification. The replies are captured instead of sent.
+ */
+void Application::RunMcpBatchCheck() {
+    const char* message = "{\"type\":\"mcp\",\"payload\":["
+        "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/list\",\"params\":{}},"
+        "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/initialized\"},"
+        "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/list\",\"params\":{\"withUserTools\":true}}]}";
+    std::vector<std::string> replies;
+    mcp_check_replies_ = &replies;
+    cJSON* root = cJSON_Parse(message);
+    HandleIncomingJson(root);
+    cJSON_Delete(root);
+    mcp_check_replies_ = nullptr;
+
+    bool passed = false;
+    if (replies.size() == 1) {
+        cJSON* reply = cJSON_Parse(replies[0].c_str());
+        if (cJSON_IsArray(reply) && cJSON_GetArraySize(reply) == 2) {
+            passed = true;
+            for (int i = 0; i < 2; i++) {
+                auto response = cJSON_GetArrayItem(reply, i);
+                auto id = cJSON_GetObjectItem(response, "id");
+                if (!cJSON_IsNumber(id) || id->valueint != i + 1 || !cJSON_IsObject(cJSON_GetObjectItem(response, "result"))) {
+                    passed = false;
+                }
             }
         }
-    });
-    
-    protocol_->Start();
+        cJSON_Delete(reply);
+    }
+    if (passed) {
+        ESP_LOGI(TAG, "MCP batch check passed: one reply of %u bytes", replies[0].size());
+    } else {
+        ESP_LOGE(TAG, "MCP batch check failed: %u replies", replies.size());
+        for (auto& reply : replies) {
+            ESP_LOGE(TAG, "Reply: %s", reply.c_str());
+        }
+    }
 }
+#endif
 
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
     struct digit_sound {
@@ -740,6 +926,10 @@ void Application::StopListening() {
     xEventGroupSetBits(event_group_, MAIN_EVENT_STOP_LISTENING);
 }
 
+void Application::NotifyStatusChanged() {
+    xEventGroupSetBits(event_group_, MAIN_EVENT_STATUS_CHANGED);
+}
+
 void Application::HandleToggleChatEvent() {
     auto state = GetDeviceState();
     
@@ -910,6 +1100,7 @@ void Application::HandleStateChangedEvent() {
             case kDeviceStateListening:
                 display->SetStatus(Lang::Strings::LISTENING);
                 display->SetEmotion("neutral");
+                BootTimeline::GetInstance().Mark("first_listen");
 
                 if (protocol_ && old_state != kDeviceStateListening) {
                     protocol_->SendStartListening(listening_mode_);
@@ -987,7 +1178,7 @@ void Application::Reboot() {
     esp_restart();
 }
 
-bool Application::UpgradeFirmware(const std::string& url, const std::string& version) {
+bool Application::UpgradeFirmware(const std::string& url, const std::string& version, const std::string& delta_url) {
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
 
@@ -1013,13 +1204,13 @@ bool Application::UpgradeFirmware(const std::string& url, const std::string& ver
     audio_service_.Stop();
     vTaskDelay(pdMS_TO_TICKS(1000));
 
-    bool upgrade_success = Ota::Upgrade(upgrade_url, [display](int progress, size_t speed) {
-        std::thread([display, progress, speed]() {
-            char buffer[32];
-            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
+    bool upgrade_success = Ota::Upgrade(upgrade_url, [display](int progress, size_t speed, size_t flash_speed) {
+        std::thread([display, progress, speed, flash_speed]() {
+            char buffer[48];
+            snprintf(buffer, sizeof(buffer), "%d%% %uKB/s (flash %uKB/s)", progress, speed / 1024, flash_speed / 1024);
             display->SetChatMessage("system", buffer);
         }).detach();
-    });
+    }, delta_url);
 
     if (!upgrade_success) {
         // Upgrade failed, restart audio service and continue running
@@ -1103,6 +1294,12 @@ bool Application::CanEnterSleepMode() {
 }
 
 void Application::SendMcpMessage(const std::string& payload) {
+#if CONFIG_MCP_BATCH_SELF_CHECK
+    if (mcp_check_replies_ != nullptr) {
+        mcp_check_replies_->push_back(payload);
+        return;
+    }
+#endif
     // Always schedule to run in main task for thread safety
     Schedule([this, payload = std::move(payload)]() {
         if (protocol_) {
@@ -1111,6 +1308,35 @@ void Application::SendMcpMessage(const std::string& payload) {
     });
 }
 
+void Application::SendMcpMessage(std::function<void(JsonWriter& writer)>&& write_payload) {
+#if CONFIG_MCP_BATCH_SELF_CHECK
+    if (mcp_check_replies_ != nullptr) {
+        std::string payload;
+        char buffer[256];
+        JsonWriter writer(buffer, sizeof(buffer), [&payload](const char* data, size_t length, bool last) {
+            payload.append(data, length);
+            return true;
+        });
+        write_payload(writer);
+        writer.Finish();
+        mcp_check_replies_->push_back(std::move(payload));
+        return;
+    }
+#endif
+    // Tools run on the main task, so their progress notifications must not wait for the queue
+    if (main_task_handle_ != nullptr && xTaskGetCurrentTaskHandle() == main_task_handle_) {
+        if (protocol_) {
+            protocol_->SendMcpMessage(write_payload);
+        }
+        return;
+    }
+    Schedule([this, write_payload = std::move(write_payload)]() {
+        if (protocol_) {
+            protocol_->SendMcpMessage(write_payload);
+        }
+    });
+}
+
 void Application::SetAecMode(AecMode mode) {
     aec_mode_ = mode;
     Schedule([this]() {
@@ -10,7 +10,9 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <vector>
 #include <utility>
+#include <ctime>
 
 #include "protocol.h"
 #include "ota.h"
@@ -32,6 +34,7 @@
 #define MAIN_EVENT_START_LISTENING      (1 << 10)
 #define MAIN_EVENT_STOP_LISTENING       (1 << 11)
 #define MAIN_EVENT_STATE_CHANGED        (1 << 12)
+#define MAIN_EVENT_STATUS_CHANGED       (1 << 13)
 
 
 enum AecMode {
@@ -104,11 +107,20 @@ public:
      */
     void StopListening();
 
+    /**
+     * Refresh the status bar after a battery or volume change (event-based, thread-safe)
+     * Sends MAIN_EVENT_STATUS_CHANGED to be handled in Run()
+     */
+    void NotifyStatusChanged();
+
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
-    bool UpgradeFirmware(const std::string& url, const std::string& version = "");
+    bool UpgradeFirmware(const std::string& url, const std::string& version = "", const std::string& delta_url = "");
     bool CanEnterSleepMode();
     void SendMcpMessage(const std::string& payload);
+    // Stream an MCP payload to the server from the main task, fragment by fragment.
+    // When called on the main task (e.g. progress from a running tool) it is sent immediately.
+    void SendMcpMessage(std::function<void(JsonWriter& writer)>&& write_payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
@@ -142,9 +154,15 @@ private:
     bool has_server_time_ = false;
     bool aborted_ = false;
     bool assets_version_checked_ = false;
+    bool assets_applied_ = false;  // Applied during startup, before the network was up
     bool play_popup_on_listening_ = false;  // Flag to play popup sound after state changes to listening
     int clock_ticks_ = 0;
+    time_t status_bar_minute_ = 0;  // The status bar is refreshed when the minute changes
     TaskHandle_t activation_task_handle_ = nullptr;
+    TaskHandle_t main_task_handle_ = nullptr;
+#if CONFIG_MCP_BATCH_SELF_CHECK
+    std::vector<std::string>* mcp_check_replies_ = nullptr;  // Captures the MCP replies instead of sending them
+#endif
 
 
     // Event handlers
@@ -156,6 +174,7 @@ private:
     void HandleNetworkDisconnectedEvent();
     void HandleActivationDoneEvent();
     void HandleWakeWordDetectedEvent();
+    void HandleIncomingJson(const cJSON* root);
 
     // Activation task (runs in background)
     void ActivationTask();
@@ -163,7 +182,13 @@ private:
     // Helper methods
     void CheckAssetsVersion();
     void CheckNewVersion();
+#if CONFIG_USE_CACHED_VERSION_CHECK
+    void RefreshVersionCheck();
+#endif
     void InitializeProtocol();
+#if CONFIG_MCP_BATCH_SELF_CHECK
+    void RunMcpBatchCheck();
+#endif
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
     
@@ -4,6 +4,10 @@
 #include "application.h"
 #include "lvgl_theme.h"
 #include "emote_display.h"
+#include "settings.h"
+#include "boot_timeline.h"
+#include "flash_write_pipeline.h"
+#include "lz4_block.h"
 #ifdef HAVE_LVGL
 #include "display/lcd_display.h"
 #endif
@@ -12,10 +16,23 @@
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
 #include <cbin_font.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 
 
 #define TAG "Assets"
 
+// Each file starts with a magic: "ZZ" for stored data, "ZL" for a 32-bit little endian
+// decompressed size followed by an LZ4 block (written by build_default_assets.py --compress)
+#define ASSET_MAGIC_STORED 'Z'
+#define ASSET_MAGIC_LZ4 'L'
+#define ASSETS_CACHE_SIZE (CONFIG_ASSETS_CACHE_SIZE_KB * 1024)
+// Files from this size on are aligned to MMU pages by the packer and mapped on demand
+#define LARGE_ASSET_SIZE (64 * 1024)
+
 struct mmap_assets_table {
     char asset_name[32];          /*!< Name of the asset */
     uint32_t asset_size;          /*!< Size of the asset */
@@ -24,6 +41,22 @@ struct mmap_assets_table {
     uint16_t asset_height;        /*!< Height of the asset */
 };
 
+// Delta updates write changed files into the free space after the current files, then
+// switch to a new file table (with offsets from the partition start) in one of two index
+// slots at the end of the partition. The magic is written last, so the switch is atomic.
+#define DELTA_INDEX_MAGIC 0x49445A58  // "XZDI"
+#define DELTA_INDEX_SLOT_SIZE (16 * 1024)
+
+struct delta_index_header {
+    uint32_t magic;
+    uint32_t sequence;            /*!< The slot with the highest sequence is used */
+    uint32_t files;
+    char base_digest[64];         /*!< Header digest of the image the files were added to */
+    uint8_t table_digest[32];     /*!< SHA-256 of the file table that follows */
+};
+
+#define DELTA_INDEX_MAX_FILES ((DELTA_INDEX_SLOT_SIZE - sizeof(delta_index_header)) / sizeof(mmap_assets_table))
+
 
 Assets::Assets() {
     // Initialize the partition
@@ -31,9 +64,8 @@ Assets::Assets() {
 }
 
 Assets::~Assets() {
-    if (mmap_handle_ != 0) {
-        esp_partition_munmap(mmap_handle_);
-    }
+    ClearCache();
+    UnmapPartition();
 }
 
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
@@ -44,10 +76,146 @@ uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
     return checksum & 0xFFFF;
 }
 
+static std::string ToHex(const uint8_t* data, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(length * 2);
+    for (size_t i = 0; i < length; i++) {
+        result.push_back(hex[data[i] >> 4]);
+        result.push_back(hex[data[i] & 0x0F]);
+    }
+    return result;
+}
+
+// SHA-256 of the partition location, the header and the file table. A partition whose
+// header digest was recorded after a full verification does not need to be read again.
+std::string Assets::CalculateHeaderDigest(uint32_t header_length) {
+    uint8_t digest[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, (const uint8_t*)&partition_->address, sizeof(partition_->address));
+    mbedtls_sha256_update(&ctx, (const uint8_t*)&partition_->size, sizeof(partition_->size));
+    mbedtls_sha256_update(&ctx, (const uint8_t*)mmap_root_, header_length);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    return ToHex(digest, sizeof(digest));
+}
+
+// Read the content once, checking the stored checksum and computing its SHA-256
+// (done by the SHA peripheral when CONFIG_MBEDTLS_HARDWARE_SHA is enabled).
+// It is read without mapping, most of the partition is only mapped on demand.
+bool Assets::VerifyContent(uint32_t length, uint32_t expected_checksum, std::string& digest) {
+    const uint32_t kChunkSize = 4096;
+    auto buffer = (char*)heap_caps_malloc(kChunkSize, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the verification buffer");
+        return false;
+    }
+    uint32_t checksum = 0;
+    esp_err_t err = ESP_OK;
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (uint32_t offset = 0; offset < length && err == ESP_OK; offset += kChunkSize) {
+        uint32_t chunk = std::min(kChunkSize, length - offset);
+        err = esp_partition_read(partition_, 12 + offset, buffer, chunk);
+        checksum += CalculateChecksum(buffer, chunk);
+        mbedtls_sha256_update(&ctx, (const uint8_t*)buffer, chunk);
+    }
+    uint8_t sha256[32];
+    mbedtls_sha256_finish(&ctx, sha256);
+    mbedtls_sha256_free(&ctx);
+    heap_caps_free(buffer);
+    digest = ToHex(sha256, sizeof(sha256));
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read assets partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    checksum &= 0xFFFF;
+    if (checksum != expected_checksum) {
+        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", checksum, expected_checksum);
+        return false;
+    }
+    return true;
+}
+
+// Map the partition from its start, replacing the current mapping if it is smaller
+bool Assets::MapPrefix(uint32_t size) {
+    if (size <= hot_size_) {
+        return true;
+    }
+    if (mmap_handle_ != 0) {
+        esp_partition_munmap(mmap_handle_);
+        mmap_handle_ = 0;
+        mmap_root_ = nullptr;
+        hot_size_ = 0;
+    }
+    esp_err_t err = esp_partition_mmap(partition_, 0, size, ESP_PARTITION_MMAP_DATA, (const void**)&mmap_root_, &mmap_handle_);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mmap %lu bytes of assets partition: %s", size, esp_err_to_name(err));
+        return false;
+    }
+    hot_size_ = size;
+    return true;
+}
+
+// Returns the data at offset, mapping the pages it is on if they are out of the hot region.
+// Mappings are kept until the partition is unmapped, fonts and images hold on to the data.
+const char* Assets::MapRange(uint32_t offset, uint32_t size) {
+    if ((uint64_t)offset + size > partition_->size) {
+        return nullptr;
+    }
+    if (offset + size <= hot_size_) {
+        return mmap_root_ + offset;
+    }
+
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    for (const auto& map : demand_maps_) {
+        if (offset >= map.offset && offset + size <= map.offset + map.size) {
+            return map.data + (offset - map.offset);
+        }
+    }
+    DemandMap map = {offset, size, 0, nullptr};
+    esp_err_t err = esp_partition_mmap(partition_, offset, size, ESP_PARTITION_MMAP_DATA, (const void**)&map.data, &map.handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mmap %lu bytes at 0x%lx of assets partition: %s", size, offset, esp_err_to_name(err));
+        return nullptr;
+    }
+    demand_maps_.push_back(map);
+    ESP_LOGD(TAG, "Mapped %lu bytes at 0x%lx, %u mmap pages free", size, offset,
+        spi_flash_mmap_get_free_pages(SPI_FLASH_MMAP_DATA));
+    return map.data;
+}
+
+void Assets::UnmapPartition() {
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    for (auto& map : demand_maps_) {
+        esp_partition_munmap(map.handle);
+    }
+    demand_maps_.clear();
+    if (mmap_handle_ != 0) {
+        esp_partition_munmap(mmap_handle_);
+        mmap_handle_ = 0;
+        mmap_root_ = nullptr;
+    }
+    hot_size_ = 0;
+}
+
 bool Assets::InitializePartition() {
+    UnmapPartition();
     partition_valid_ = false;
     checksum_valid_ = false;
-    assets_.clear();
+    table_ = nullptr;
+    table_count_ = 0;
+    sorted_index_.clear();
+    header_digest_.clear();
+    image_end_ = 0;
+    delta_slot_ = -1;
+    delta_sequence_ = 0;
+    ClearCache();
 
     partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
     if (partition_ == nullptr) {
@@ -59,51 +227,195 @@ bool Assets::InitializePartition() {
     uint32_t storage_size = free_pages * 64 * 1024;
     ESP_LOGI(TAG, "The storage free size is %ld KB", storage_size / 1024);
     ESP_LOGI(TAG, "The partition size is %ld KB", partition_->size / 1024);
-    if (storage_size < partition_->size) {
-        ESP_LOGE(TAG, "The free size %ld KB is less than assets partition required %ld KB", storage_size / 1024, partition_->size / 1024);
-        return false;
-    }
 
-    esp_err_t err = esp_partition_mmap(partition_, 0, partition_->size, ESP_PARTITION_MMAP_DATA, (const void**)&mmap_root_, &mmap_handle_);
+    uint32_t header[3];
+    esp_err_t err = esp_partition_read(partition_, 0, header, sizeof(header));
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to mmap assets partition: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Failed to read assets partition: %s", esp_err_to_name(err));
         return false;
     }
 
     partition_valid_ = true;
 
-    uint32_t stored_files = *(uint32_t*)(mmap_root_ + 0);
-    uint32_t stored_chksum = *(uint32_t*)(mmap_root_ + 4);
-    uint32_t stored_len = *(uint32_t*)(mmap_root_ + 8);
+    uint32_t stored_files = header[0];
+    uint32_t stored_chksum = header[1];
+    uint32_t stored_len = header[2];
 
     if (stored_len > partition_->size - 12) {
         ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len, partition_->size);
         return false;
     }
 
-    auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+    uint64_t header_length = 12 + (uint64_t)sizeof(mmap_assets_table) * stored_files;
+    if (header_length > (uint64_t)stored_len + 12) {
+        ESP_LOGE(TAG, "The file table of %lu files does not fit in the stored length (0x%lx)", stored_files, stored_len);
+        return false;
+    }
 
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+    // Only the header, the file table and the small files in front of the first large one are
+    // mapped now. build_default_assets.py puts the files used first there, the rest is mapped on demand.
+    if (!MapPrefix(header_length)) {
+        return false;
+    }
+    uint32_t hot_end = 12 + stored_len;
+    auto table = (const mmap_assets_table*)(mmap_root_ + 12);
+    for (uint32_t i = 0; i < stored_files; i++) {
+        if (table[i].asset_size >= LARGE_ASSET_SIZE) {
+            hot_end = std::min<uint64_t>(hot_end, header_length + table[i].asset_offset);
+        }
+    }
+    if (!MapPrefix(std::max<uint32_t>(hot_end, header_length))) {
         return false;
     }
+    ESP_LOGI(TAG, "Mapped %lu KB of assets, %u mmap pages free", hot_size_ / 1024, spi_flash_mmap_get_free_pages(SPI_FLASH_MMAP_DATA));
+
+    // Verify the whole content only the first time this header is seen
+    Settings settings("assets", true);
+    auto header_digest = CalculateHeaderDigest(header_length);
+    if (settings.GetString("verified") == header_digest) {
+        ESP_LOGI(TAG, "The assets partition was verified before, skipping the checksum");
+    } else {
+        auto start_time = esp_timer_get_time();
+        BootTimeline::GetInstance().Begin("assets_checksum");
+        std::string digest;
+        bool valid = VerifyContent(stored_len, stored_chksum, digest);
+        BootTimeline::GetInstance().End("assets_checksum");
+        auto end_time = esp_timer_get_time();
+        ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+        if (!valid) {
+            return false;
+        }
+        settings.SetString("verified", header_digest);
+        settings.SetString("sha256", digest);
+    }
 
     checksum_valid_ = true;
+    header_digest_ = header_digest;
+    image_end_ = 12 + stored_len;
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+    if (!LoadDeltaIndex()) {
+        table_ = (const mmap_assets_table*)(mmap_root_ + 12);
+        table_count_ = stored_files;
+        data_offset_ = header_length;
     }
+    BuildIndex();
+    accessed_.assign(table_count_, false);
+    access_order_.clear();
+#if CONFIG_ASSETS_DECOMPRESS_BENCHMARK
+    RunDecompressBenchmark();
+#endif
     return checksum_valid_;
 }
 
+static void CalculateSha256(const void* data, size_t length, uint8_t digest[32]) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, (const uint8_t*)data, length);
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+}
+
+// Use the newest delta index written on top of the current image, if there is one
+bool Assets::LoadDeltaIndex() {
+    if (partition_->size < image_end_ + 2 * DELTA_INDEX_SLOT_SIZE) {
+        return false;
+    }
+    uint32_t index_start = partition_->size - 2 * DELTA_INDEX_SLOT_SIZE;
+    auto index = MapRange(index_start, 2 * DELTA_INDEX_SLOT_SIZE);
+    if (index == nullptr) {
+        return false;
+    }
+    const delta_index_header* best = nullptr;
+    int best_slot = -1;
+    for (int slot = 0; slot < 2; slot++) {
+        auto header = (const delta_index_header*)(index + slot * DELTA_INDEX_SLOT_SIZE);
+        if (header->magic != DELTA_INDEX_MAGIC || header->files > DELTA_INDEX_MAX_FILES ||
+            header_digest_.compare(0, sizeof(header->base_digest), header->base_digest, sizeof(header->base_digest)) != 0) {
+            continue;
+        }
+        uint8_t digest[32];
+        CalculateSha256(header + 1, header->files * sizeof(mmap_assets_table), digest);
+        if (memcmp(digest, header->table_digest, sizeof(digest)) != 0) {
+            ESP_LOGW(TAG, "The delta index in slot %d is corrupted", slot);
+            continue;
+        }
+        if (best == nullptr || header->sequence > best->sequence) {
+            best = header;
+            best_slot = slot;
+        }
+    }
+    if (best == nullptr) {
+        return false;
+    }
+
+    auto table = (const mmap_assets_table*)(best + 1);
+    for (uint32_t i = 0; i < best->files; i++) {
+        if ((uint64_t)table[i].asset_offset + 2 + table[i].asset_size > index_start) {
+            ESP_LOGE(TAG, "The delta index has an asset out of the data area");
+            return false;
+        }
+    }
+    table_ = table;
+    table_count_ = best->files;
+    data_offset_ = 0;
+    delta_slot_ = best_slot;
+    delta_sequence_ = best->sequence;
+    ESP_LOGI(TAG, "Using delta index %lu in slot %d with %lu files", delta_sequence_, delta_slot_, table_count_);
+    return true;
+}
+
+static int CompareName(const mmap_assets_table* item, const char* name) {
+    return strncmp(item->asset_name, name, sizeof(item->asset_name));
+}
+
+void Assets::BuildIndex() {
+    // build_default_assets.py sorts the table by name, so it can be searched in place
+    bool sorted = true;
+    for (uint32_t i = 1; i < table_count_ && sorted; i++) {
+        sorted = strncmp(table_[i - 1].asset_name, table_[i].asset_name, sizeof(table_[i].asset_name)) < 0;
+    }
+    if (sorted) {
+        return;
+    }
+
+    if (table_count_ > UINT16_MAX) {
+        ESP_LOGE(TAG, "Too many assets to index: %lu", table_count_);
+        table_count_ = 0;
+        return;
+    }
+    ESP_LOGW(TAG, "The assets table is not sorted by name, indexing %lu files", table_count_);
+    sorted_index_.resize(table_count_);
+    for (uint32_t i = 0; i < table_count_; i++) {
+        sorted_index_[i] = i;
+    }
+    std::sort(sorted_index_.begin(), sorted_index_.end(), [this](uint16_t a, uint16_t b) {
+        return strncmp(table_[a].asset_name, table_[b].asset_name, sizeof(table_[a].asset_name)) < 0;
+    });
+}
+
+const mmap_assets_table* Assets::FindAsset(const char* name) const {
+    if (strlen(name) > sizeof(table_->asset_name)) {
+        return nullptr;
+    }
+    // Binary search over the table, through sorted_index_ if there is one
+    uint32_t low = 0;
+    uint32_t high = table_count_;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        auto item = &table_[sorted_index_.empty() ? middle : sorted_index_[middle]];
+        int result = CompareName(item, name);
+        if (result == 0) {
+            return item;
+        } else if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return nullptr;
+}
+
 bool Assets::Apply() {
     void* ptr = nullptr;
     size_t size = 0;
@@ -134,7 +446,9 @@ bool Assets::Apply() {
                 esp_srmodel_deinit(models_list_);
                 models_list_ = nullptr;
             }
+            BootTimeline::GetInstance().Begin("srmodel_load");
             models_list_ = srmodel_load(static_cast<uint8_t*>(ptr));
+            BootTimeline::GetInstance().End("srmodel_load");
             if (models_list_ != nullptr) {
                 auto& app = Application::GetInstance();
                 app.GetAudioService().SetModelsList(models_list_);
@@ -186,7 +500,7 @@ bool Assets::Apply() {
                         ESP_LOGE(TAG, "Emoji %s image file %s is not found", name->valuestring, file->valuestring);
                         continue;
                     }
-                    custom_emoji_collection->AddEmoji(name->valuestring, new LvglRawImage(ptr, size));
+                    custom_emoji_collection->AddEmoji(name->valuestring, ptr, size);
                 }
             }
         }
@@ -379,154 +693,628 @@ bool Assets::Apply() {
 #endif
 
     cJSON_Delete(root);
+    ESP_LOGI(TAG, "Assets used: %s", GetAccessOrder().c_str());
     return true;
 }
 
+std::string Assets::GetAccessOrder() {
+    std::lock_guard<std::mutex> lock(map_mutex_);
+    std::string order;
+    for (auto index : access_order_) {
+        if (!order.empty()) {
+            order += ",";
+        }
+        order.append(table_[index].asset_name, strnlen(table_[index].asset_name, sizeof(table_[index].asset_name)));
+    }
+    return order;
+}
+
 bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
     ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
+
+    // 先尝试只下载有变化的文件，服务器没有清单或空间不足时下载整个分区
+    if (DownloadDelta(url, progress_callback)) {
+        return true;
+    }
     
     // 取消当前资源分区的内存映射
-    if (mmap_handle_ != 0) {
-        esp_partition_munmap(mmap_handle_);
-        mmap_handle_ = 0;
-        mmap_root_ = nullptr;
-    }
+    UnmapPartition();
     checksum_valid_ = false;
-    assets_.clear();
+    table_ = nullptr;
+    table_count_ = 0;
+    sorted_index_.clear();
+    ClearCache();
+
+    // 下载过程中分区内容不完整，清除校验记录并立即写入 NVS
+    {
+        Settings settings("assets", true);
+        settings.EraseKey("verified");
+        settings.EraseKey("sha256");
+        settings.Commit();
+    }
+
+    // 如果上次下载同一个 URL 时中断，从已写入的位置继续（断电后 download_url 仍然保留）
+    Settings settings("assets", true);
+    size_t content_length = 0;
+    size_t received = 0;
+    if (settings.GetString("dl_url") == url) {
+        content_length = settings.GetInt("dl_length");
+        received = settings.GetInt("dl_offset");
+        if (content_length == 0 || received >= content_length) {
+            content_length = 0;
+            received = 0;
+        } else {
+            ESP_LOGI(TAG, "Resuming assets download at %u/%u", received, content_length);
+        }
+    }
+
+    // 网络读取和 Flash 擦写在两个任务中并行，擦除在写入位置之前提前进行
+    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
+
+    // 新的完整镜像不使用之前的增量索引
+    if (received == 0 && partition_->size >= 2 * DELTA_INDEX_SLOT_SIZE) {
+        esp_err_t err = esp_partition_erase_range(partition_, partition_->size - 2 * DELTA_INDEX_SLOT_SIZE, 2 * DELTA_INDEX_SLOT_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase the delta index: %s", esp_err_to_name(err));
+            return false;
+        }
+    }
+    const size_t ERASE_AHEAD = 64 * 1024;
+    const size_t PROGRESS_INTERVAL = 64 * 1024;
+    size_t write_offset = received;
+    size_t erased_end = received;
+    size_t saved_offset = received;
+    auto erase_next_sector = [this, &erased_end, SECTOR_SIZE]() {
+        esp_err_t err = esp_partition_erase_range(partition_, erased_end, SECTOR_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase sector at offset %u: %s", erased_end, esp_err_to_name(err));
+            return false;
+        }
+        erased_end += SECTOR_SIZE;
+        return true;
+    };
+    FlashWritePipeline pipeline(8 * 1024, 2, [&](const char* data, size_t length) {
+        while (erased_end < write_offset + length) {
+            if (!erase_next_sector()) {
+                return false;
+            }
+        }
+        esp_err_t err = esp_partition_write(partition_, write_offset, data, length);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", write_offset, esp_err_to_name(err));
+            return false;
+        }
+        write_offset += length;
+        // 保存已完整写入的扇区边界，恢复时从该扇区重新擦除写入
+        if (write_offset - saved_offset >= PROGRESS_INTERVAL) {
+            saved_offset = write_offset / SECTOR_SIZE * SECTOR_SIZE;
+            settings.SetInt("dl_offset", saved_offset);
+            settings.Commit();
+        }
+        return true;
+    }, [&]() {
+        size_t erase_limit = std::min(std::min(write_offset + ERASE_AHEAD, content_length), (size_t)partition_->size);
+        return erased_end < erase_limit && erase_next_sector();
+    });
 
-    // 下载新的资源文件
+    const int MAX_RETRIES = 3;
     auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t start_offset = received;
+    size_t recent_received = 0;
+    bool pipeline_started = false;
+    bool completed = false;
+    for (int attempt = 0; attempt <= MAX_RETRIES && !completed && !pipeline.failed(); attempt++) {
+        if (attempt > 0) {
+            ESP_LOGW(TAG, "Assets download interrupted at %u/%u, retrying (%d/%d)", received, content_length, attempt, MAX_RETRIES);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+
+        auto http = network->CreateHttp(0);
+        if (received > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(received) + "-");
+        }
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+            continue;
+        }
+
+        // 服务器不支持 Range 时返回 200，跳过已经写入的部分
+        int status_code = http->GetStatusCode();
+        size_t skip = 0;
+        size_t total_length = 0;
+        if (status_code == 206 && received > 0) {
+            total_length = received + http->GetBodyLength();
+        } else if (status_code == 200) {
+            skip = received;
+            total_length = http->GetBodyLength();
+        } else {
+            ESP_LOGE(TAG, "Failed to get assets, status code: %d", status_code);
+            return false;
+        }
+
+        if (content_length != 0 && total_length != content_length) {
+            if (pipeline_started || start_offset == 0) {
+                ESP_LOGE(TAG, "Assets size changed during download: %u -> %u", content_length, total_length);
+                return false;
+            }
+            // 保存的进度属于另一个版本的文件，从头开始下载
+            ESP_LOGW(TAG, "Assets size changed from %u to %u, restarting download", content_length, total_length);
+            http->Close();
+            content_length = 0;
+            received = write_offset = erased_end = saved_offset = start_offset = 0;
+            attempt--;
+            continue;
+        }
+
+        if (content_length == 0) {
+            content_length = total_length;
+            if (content_length == 0) {
+                ESP_LOGE(TAG, "Failed to get content length");
+                return false;
+            }
+            if (content_length > partition_->size) {
+                ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
+                return false;
+            }
+            settings.SetString("dl_url", url);
+            settings.SetInt("dl_length", content_length);
+            settings.SetInt("dl_offset", 0);
+            settings.Commit();
+        }
+        if (!pipeline_started) {
+            if (!pipeline.Start("assets_write")) {
+                return false;
+            }
+            pipeline_started = true;
+        }
+
+        while (received < content_length && !pipeline.failed()) {
+            char* buffer = pipeline.AcquireBuffer();
+            size_t filled = 0;
+            int ret = 0;
+            while (filled < pipeline.buffer_size() && received + filled < content_length) {
+                size_t to_read = std::min(pipeline.buffer_size() - filled, content_length - received - filled);
+                ret = http->Read(buffer + filled, skip > 0 ? std::min(to_read, skip) : to_read);
+                if (ret <= 0) {
+                    break;
+                }
+                if (skip > 0) {
+                    skip -= ret;
+                    continue;
+                }
+                filled += ret;
+            }
+            pipeline.Submit(buffer, filled);
+            received += filled;
+            recent_received += filled;
+
+            // 计算进度和速度
+            auto now = esp_timer_get_time();
+            if (now - last_calc_time >= 1000000 || received == content_length) {
+                size_t progress = received * 100 / content_length;
+                size_t speed = recent_received * 1000000 / std::max<int64_t>(now - last_calc_time, 1);
+                ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s", progress, received, content_length, speed);
+                if (progress_callback) {
+                    progress_callback(progress, speed);
+                }
+                last_calc_time = now;
+                recent_received = 0;
+            }
+
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                break;
+            }
+            if (ret == 0 && received < content_length) {
+                ESP_LOGE(TAG, "Connection closed at %u/%u", received, content_length);
+                break;
+            }
+        }
+        http->Close();
+        completed = received == content_length;
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
+    bool written = pipeline_started && pipeline.Finish();
+    auto elapsed_us = std::max<int64_t>(esp_timer_get_time() - start_time, 1);
+    ESP_LOGI(TAG, "Downloaded %u bytes in %d ms, %u KB/s; flash busy %d ms, waiting for flash %d ms",
+        received - start_offset, int(elapsed_us / 1000), size_t((received - start_offset) * 1000000ULL / elapsed_us / 1024),
+        int(pipeline.flash_busy_us() / 1000), int(pipeline.wait_us() / 1000));
+    if (!completed || !written) {
+        ESP_LOGE(TAG, "Failed to download assets, %u/%u bytes written", write_offset, content_length);
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    settings.EraseKey("dl_url");
+    settings.EraseKey("dl_length");
+    settings.EraseKey("dl_offset");
+    settings.Commit();
+    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes", write_offset);
+
+    // 重新初始化资源分区
+    if (!InitializePartition()) {
+        ESP_LOGE(TAG, "Failed to re-initialize assets partition");
         return false;
     }
 
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
+    return true;
+}
+
+static bool ParseSha256(const char* hex, uint8_t digest[32]) {
+    if (strlen(hex) != 64) {
         return false;
     }
-
-    // 定义扇区大小为4KB（ESP32的标准扇区大小）
-    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char buffer[512];
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+    for (int i = 0; i < 32; i++) {
+        unsigned int byte;
+        if (sscanf(hex + i * 2, "%2x", &byte) != 1) {
             return false;
         }
+        digest[i] = byte;
+    }
+    return true;
+}
+
+/*
+ * The packer writes <assets>.manifest.json next to the image:
+ * {"version":1,"files":[{"name":"index.json","offset":1234,"size":256,"sha256":"..."}]}
+ * offset and size cover the stored bytes of each file in the image, magic included, so
+ * changed files are fetched from the image itself with HTTP Range requests.
+ */
+bool Assets::DownloadDelta(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback) {
+    if (!checksum_valid_ || partition_->size < image_end_ + 2 * DELTA_INDEX_SLOT_SIZE) {
+        return false;
+    }
+    const uint32_t index_start = partition_->size - 2 * DELTA_INDEX_SLOT_SIZE;
+
+    std::string manifest_url = url;
+    manifest_url.insert(std::min(manifest_url.find('?'), manifest_url.size()), ".manifest.json");
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
+    if (!http->Open("GET", manifest_url)) {
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGI(TAG, "No delta manifest (status %d), downloading the whole assets", http->GetStatusCode());
+        return false;
+    }
+    std::string body = http->ReadAll();
+    http->Close();
 
-        if (ret == 0) {
-            break;
+    struct DeltaFile {
+        std::string name;
+        uint32_t source_offset;
+        uint32_t size;
+        uint8_t sha256[32];
+        uint32_t offset;
+        bool download;
+    };
+    std::vector<DeltaFile> files;
+    cJSON* root = cJSON_Parse(body.c_str());
+    cJSON* items = cJSON_GetObjectItem(root, "files");
+    bool valid = cJSON_IsArray(items);
+    for (int i = 0; valid && i < cJSON_GetArraySize(items); i++) {
+        cJSON* item = cJSON_GetArrayItem(items, i);
+        cJSON* name = cJSON_GetObjectItem(item, "name");
+        cJSON* offset = cJSON_GetObjectItem(item, "offset");
+        cJSON* size = cJSON_GetObjectItem(item, "size");
+        cJSON* sha256 = cJSON_GetObjectItem(item, "sha256");
+        DeltaFile file = {};
+        valid = cJSON_IsString(name) && strlen(name->valuestring) <= sizeof(mmap_assets_table::asset_name) &&
+            cJSON_IsNumber(offset) && cJSON_IsNumber(size) && size->valuedouble >= 2 &&
+            cJSON_IsString(sha256) && ParseSha256(sha256->valuestring, file.sha256);
+        if (valid) {
+            file.name = name->valuestring;
+            file.source_offset = offset->valuedouble;
+            file.size = size->valuedouble;
+            files.push_back(file);
         }
+    }
+    cJSON_Delete(root);
+    if (!valid || files.empty() || files.size() > DELTA_INDEX_MAX_FILES) {
+        ESP_LOGW(TAG, "The delta manifest is not valid");
+        return false;
+    }
 
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
-            // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
-                return false;
+    // Keep the files whose stored bytes are the same, new data goes after the last used byte
+    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
+    uint32_t data_end = image_end_;
+    for (uint32_t i = 0; i < table_count_; i++) {
+        data_end = std::max<uint32_t>(data_end, data_offset_ + table_[i].asset_offset + 2 + table_[i].asset_size);
+    }
+    uint32_t write_offset = (data_end + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+    size_t download_size = 0;
+    for (auto& file : files) {
+        auto item = FindAsset(file.name.c_str());
+        file.download = true;
+        if (item != nullptr && item->asset_size + 2 == file.size) {
+            uint8_t digest[32];
+            auto data = MapRange(data_offset_ + item->asset_offset, file.size);
+            if (data != nullptr) {
+                CalculateSha256(data, file.size, digest);
+            }
+            if (data != nullptr && memcmp(digest, file.sha256, sizeof(digest)) == 0) {
+                file.offset = data_offset_ + item->asset_offset;
+                file.download = false;
             }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
+        }
+        if (file.download) {
+            file.offset = write_offset + download_size;
+            download_size += file.size;
+        }
+    }
+    if ((uint64_t)write_offset + download_size > index_start) {
+        ESP_LOGW(TAG, "No room for a delta update of %u bytes, downloading the whole assets", download_size);
+        return false;
+    }
+    ESP_LOGI(TAG, "Delta update: downloading %u bytes for %d of %u files",
+        download_size, (int)std::count_if(files.begin(), files.end(), [](const DeltaFile& file) { return file.download; }), files.size());
+
+    // Only free space is written, the current index stays usable until the switch
+    uint32_t erased_end = write_offset;
+    uint32_t written_end = write_offset;
+    FlashWritePipeline pipeline(8 * 1024, 2, [&](const char* data, size_t length) {
+        while (erased_end < written_end + length) {
+            esp_err_t err = esp_partition_erase_range(partition_, erased_end, SECTOR_SIZE);
             if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
+                ESP_LOGE(TAG, "Failed to erase sector at offset %lu: %s", erased_end, esp_err_to_name(err));
                 return false;
             }
-            
-            current_sector++;
+            erased_end += SECTOR_SIZE;
         }
-
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
+        esp_err_t err = esp_partition_write(partition_, written_end, data, length);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to write to assets partition at offset %lu: %s", written_end, esp_err_to_name(err));
+            return false;
+        }
+        written_end += length;
+        return true;
+    });
+    if (download_size > 0 && !pipeline.Start("assets_write")) {
+        return false;
+    }
+
+    size_t received = 0;
+    auto last_calc_time = esp_timer_get_time();
+    size_t recent_received = 0;
+    for (const auto& file : files) {
+        if (!file.download) {
+            continue;
+        }
+        http = network->CreateHttp(0);
+        http->SetHeader("Range", "bytes=" + std::to_string(file.source_offset) + "-" +
+            std::to_string(file.source_offset + file.size - 1));
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+            return false;
+        }
+        if (http->GetStatusCode() != 206 || http->GetBodyLength() != file.size) {
+            ESP_LOGW(TAG, "The server does not support range requests (status %d)", http->GetStatusCode());
             return false;
         }
 
-        total_written += ret;
-        recent_written += ret;
+        mbedtls_sha256_context ctx;
+        mbedtls_sha256_init(&ctx);
+        mbedtls_sha256_starts(&ctx, 0);
+        size_t file_received = 0;
+        while (file_received < file.size && !pipeline.failed()) {
+            char* buffer = pipeline.AcquireBuffer();
+            size_t filled = 0;
+            while (filled < pipeline.buffer_size() && file_received + filled < file.size) {
+                int ret = http->Read(buffer + filled, std::min(pipeline.buffer_size() - filled, file.size - file_received - filled));
+                if (ret <= 0) {
+                    break;
+                }
+                filled += ret;
+            }
+            mbedtls_sha256_update(&ctx, (const uint8_t*)buffer, filled);
+            pipeline.Submit(buffer, filled);
+            if (filled == 0) {
+                break;
+            }
+            file_received += filled;
+            received += filled;
+            recent_received += filled;
 
-        // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
-            if (progress_callback) {
-                progress_callback(progress, speed);
+            auto now = esp_timer_get_time();
+            if (now - last_calc_time >= 1000000 || received == download_size) {
+                size_t progress = received * 100 / download_size;
+                size_t speed = recent_received * 1000000 / std::max<int64_t>(now - last_calc_time, 1);
+                ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s", progress, received, download_size, speed);
+                if (progress_callback) {
+                    progress_callback(progress, speed);
+                }
+                last_calc_time = now;
+                recent_received = 0;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
+        }
+        http->Close();
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&ctx, digest);
+        mbedtls_sha256_free(&ctx);
+        if (file_received != file.size || memcmp(digest, file.sha256, sizeof(digest)) != 0) {
+            ESP_LOGE(TAG, "Failed to download %s for the delta update", file.name.c_str());
+            return false;
         }
     }
-    
-    http->Close();
-
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
+    if (download_size > 0 && !pipeline.Finish()) {
         return false;
     }
 
-    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
-             total_written, current_sector);
+    std::vector<mmap_assets_table> table(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        strncpy(table[i].asset_name, files[i].name.c_str(), sizeof(table[i].asset_name));
+        table[i].asset_size = files[i].size - 2;
+        table[i].asset_offset = files[i].offset;
+    }
+    if (!WriteDeltaIndex(table)) {
+        return false;
+    }
 
-    // 重新初始化资源分区
-    if (!InitializePartition()) {
+    // 重新映射分区，使用新的索引
+    if (!InitializePartition() || delta_slot_ < 0) {
         ESP_LOGE(TAG, "Failed to re-initialize assets partition");
         return false;
     }
+    ESP_LOGI(TAG, "Delta update completed, %u bytes written", download_size);
+    return true;
+}
+
+bool Assets::WriteDeltaIndex(std::vector<mmap_assets_table>& table) {
+    std::sort(table.begin(), table.end(), [](const mmap_assets_table& a, const mmap_assets_table& b) {
+        return strncmp(a.asset_name, b.asset_name, sizeof(a.asset_name)) < 0;
+    });
+
+    // The slot not in use is rewritten, with its magic left erased until everything else is written
+    int slot = delta_slot_ == 0 ? 1 : 0;
+    uint32_t slot_offset = partition_->size - (2 - slot) * DELTA_INDEX_SLOT_SIZE;
+    delta_index_header header = {};
+    header.magic = 0xFFFFFFFF;
+    header.sequence = delta_sequence_ + 1;
+    header.files = table.size();
+    memcpy(header.base_digest, header_digest_.data(), std::min(header_digest_.size(), sizeof(header.base_digest)));
+    CalculateSha256(table.data(), table.size() * sizeof(mmap_assets_table), header.table_digest);
 
+    esp_err_t err = esp_partition_erase_range(partition_, slot_offset, DELTA_INDEX_SLOT_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition_, slot_offset, &header, sizeof(header));
+    }
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition_, slot_offset + sizeof(header), table.data(), table.size() * sizeof(mmap_assets_table));
+    }
+    if (err == ESP_OK) {
+        uint32_t magic = DELTA_INDEX_MAGIC;
+        err = esp_partition_write(partition_, slot_offset, &magic, sizeof(magic));
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write the delta index: %s", esp_err_to_name(err));
+        return false;
+    }
     return true;
 }
 
-bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+bool Assets::GetAssetData(const char* name, void*& ptr, size_t& size) {
+    auto item = FindAsset(name);
+    if (item == nullptr) {
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
-    if (data[0] != 'Z' || data[1] != 'Z') {
-        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
+    auto data = MapRange(data_offset_ + item->asset_offset, item->asset_size + 2);
+    if (data == nullptr) {
+        ESP_LOGE(TAG, "The asset %s is out of the partition", name);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(map_mutex_);
+        size_t index = item - table_;
+        if (!accessed_[index]) {
+            accessed_[index] = true;
+            access_order_.push_back(index);
+        }
+    }
+    if (data[0] == ASSET_MAGIC_STORED && data[1] == ASSET_MAGIC_LZ4) {
+        return Decompress(item, (const uint8_t*)data + 2, ptr, size);
+    }
+    if (data[0] != ASSET_MAGIC_STORED || data[1] != ASSET_MAGIC_STORED) {
+        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name, data[0], data[1]);
         return false;
     }
 
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    size = item->asset_size;
+    return true;
+}
+
+bool Assets::Decompress(const mmap_assets_table* item, const uint8_t* data, void*& ptr, size_t& size) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (const auto& cached : cache_) {
+        if (cached.item == item) {
+            ptr = cached.data;
+            size = cached.size;
+            return true;
+        }
+    }
+
+    if (item->asset_size < 4) {
+        ESP_LOGE(TAG, "The compressed asset %.32s is truncated", item->asset_name);
+        return false;
+    }
+    uint32_t decompressed_size = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    if (cache_used_ + decompressed_size > ASSETS_CACHE_SIZE) {
+        ESP_LOGE(TAG, "No room to decompress %.32s (%lu bytes), %u of %d bytes cache used",
+            item->asset_name, decompressed_size, cache_used_, ASSETS_CACHE_SIZE);
+        return false;
+    }
+    auto buffer = (uint8_t*)heap_caps_malloc(decompressed_size, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)heap_caps_malloc(decompressed_size, MALLOC_CAP_8BIT);
+    }
+    if (buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %lu bytes to decompress %.32s", decompressed_size, item->asset_name);
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    if (!Lz4DecompressBlock(data + 4, item->asset_size - 4, buffer, decompressed_size)) {
+        ESP_LOGE(TAG, "The compressed asset %.32s is corrupted", item->asset_name);
+        heap_caps_free(buffer);
+        return false;
+    }
+    ESP_LOGI(TAG, "Decompressed %.32s: %lu -> %lu bytes in %d ms", item->asset_name, item->asset_size - 4,
+        decompressed_size, int((esp_timer_get_time() - start_time) / 1000));
+
+    cache_.push_back(CachedAsset{item, buffer, decompressed_size});
+    cache_used_ += decompressed_size;
+    ptr = buffer;
+    size = decompressed_size;
     return true;
 }
+
+void Assets::ClearCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (auto& cached : cache_) {
+        heap_caps_free(cached.data);
+    }
+    cache_.clear();
+    cache_used_ = 0;
+}
+
+#if CONFIG_ASSETS_DECOMPRESS_BENCHMARK
+// For each compressed asset, compare reading it from flash and decoding it against
+// reading the same number of decompressed bytes straight from flash
+void Assets::RunDecompressBenchmark() {
+    ESP_LOGI(TAG, "| Asset                            | Stored | Size   | Decode us | Read stored us");
+    for (uint32_t i = 0; i < table_count_; i++) {
+        auto item = &table_[i];
+        auto data = (const uint8_t*)MapRange(data_offset_ + item->asset_offset, item->asset_size + 2);
+        if (data == nullptr || data[0] != ASSET_MAGIC_STORED || data[1] != ASSET_MAGIC_LZ4 || item->asset_size < 4) {
+            continue;
+        }
+        uint32_t decompressed_size = data[2] | (data[3] << 8) | (data[4] << 16) | ((uint32_t)data[5] << 24);
+        auto buffer = (uint8_t*)heap_caps_malloc(decompressed_size, MALLOC_CAP_SPIRAM);
+        if (buffer == nullptr) {
+            continue;
+        }
+
+        // Decoding reads the compressed data from flash, so it is timed first while that is not cached
+        auto start_time = esp_timer_get_time();
+        bool ok = Lz4DecompressBlock(data + 6, item->asset_size - 4, buffer, decompressed_size);
+        auto decode_us = esp_timer_get_time() - start_time;
+
+        // Reading as many bytes as the decompressed asset, as if it were stored
+        uint32_t read_size = std::min<uint64_t>(decompressed_size, partition_->size - (data_offset_ + item->asset_offset));
+        auto read_data = MapRange(data_offset_ + item->asset_offset, read_size);
+        if (read_data == nullptr) {
+            heap_caps_free(buffer);
+            continue;
+        }
+        start_time = esp_timer_get_time();
+        volatile uint32_t sink = CalculateChecksum(read_data, read_size);
+        auto read_us = esp_timer_get_time() - start_time;
+        (void)sink;
+        heap_caps_free(buffer);
+
+        ESP_LOGI(TAG, "| %-32.32s | %6lu | %6lu | %9d | %14d%s", item->asset_name, item->asset_size, decompressed_size,
+            int(decode_us), int(read_us), ok ? "" : " (corrupted)");
+    }
+}
+#endif
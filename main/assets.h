@@ -1,19 +1,16 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
-#include <map>
 #include <string>
+#include <vector>
+#include <mutex>
 #include <functional>
 
 #include <cJSON.h>
 #include <esp_partition.h>
 #include <model_path.h>
 
-
-struct Asset {
-    size_t size;
-    size_t offset;
-};
+struct mmap_assets_table;
 
 class Assets {
 public:
@@ -25,11 +22,16 @@ public:
 
     bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply();
-    bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    bool GetAssetData(const char* name, void*& ptr, size_t& size);
+    inline bool GetAssetData(const std::string& name, void*& ptr, size_t& size) {
+        return GetAssetData(name.c_str(), ptr, size);
+    }
 
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
+    // Names of the assets used so far, in order, for build_default_assets.py --access_order
+    std::string GetAccessOrder();
 
 private:
     Assets();
@@ -37,16 +39,63 @@ private:
     Assets& operator=(const Assets&) = delete;
 
     bool InitializePartition();
+    bool MapPrefix(uint32_t size);
+    const char* MapRange(uint32_t offset, uint32_t size);
+    void UnmapPartition();
+    bool LoadDeltaIndex();
+    bool DownloadDelta(const std::string& url, std::function<void(int progress, size_t speed)> progress_callback);
+    bool WriteDeltaIndex(std::vector<mmap_assets_table>& table);
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    std::string CalculateHeaderDigest(uint32_t header_length);
+    bool VerifyContent(uint32_t length, uint32_t expected_checksum, std::string& digest);
+    void BuildIndex();
+    const mmap_assets_table* FindAsset(const char* name) const;
+    bool Decompress(const mmap_assets_table* item, const uint8_t* data, void*& ptr, size_t& size);
+    void ClearCache();
+    void RunDecompressBenchmark();
 
     const esp_partition_t* partition_ = nullptr;
+    // The hot region at the start of the partition is mapped at mount, the rest on demand
     esp_partition_mmap_handle_t mmap_handle_ = 0;
     const char* mmap_root_ = nullptr;
+    uint32_t hot_size_ = 0;
+    struct DemandMap {
+        uint32_t offset;
+        uint32_t size;
+        esp_partition_mmap_handle_t handle;
+        const char* data;
+    };
+    std::mutex map_mutex_;
+    std::vector<DemandMap> demand_maps_;
+    // Table positions in the order the assets were first used
+    std::vector<bool> accessed_;
+    std::vector<uint32_t> access_order_;
     bool partition_valid_ = false;
     bool checksum_valid_ = false;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
-    std::map<std::string, Asset> assets_;
+    // The file table is used in place inside the mapped partition
+    const mmap_assets_table* table_ = nullptr;
+    uint32_t table_count_ = 0;
+    uint32_t data_offset_ = 0;
+    // Table positions in name order, only needed when the packer did not sort the table
+    std::vector<uint16_t> sorted_index_;
+    // The image written by a full download, delta updates add files after it
+    std::string header_digest_;
+    uint32_t image_end_ = 0;
+    int delta_slot_ = -1;
+    uint32_t delta_sequence_ = 0;
+
+    // Compressed entries are decompressed into PSRAM on first access. The data is handed
+    // out as a plain pointer that fonts and images keep, so it stays until the next mount.
+    struct CachedAsset {
+        const mmap_assets_table* item;
+        uint8_t* data;
+        size_t size;
+    };
+    std::mutex cache_mutex_;
+    std::vector<CachedAsset> cache_;
+    size_t cache_used_ = 0;
 };
 
 #endif
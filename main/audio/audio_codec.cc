@@ -1,6 +1,8 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "settings.h"
+#include "mcp_server.h"
+#include "application.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -45,6 +47,8 @@ void AudioCodec::SetOutputVolume(int volume) {
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
+    McpServer::GetInstance().InvalidateCache(kMcpCacheKeyAudio);
+    Application::GetInstance().NotifyStatusChanged();
 }
 
 void AudioCodec::SetInputGain(float gain) {
@@ -1,4 +1,5 @@
 #include "adc_battery_monitor.h"
+#include "application.h"
 
 AdcBatteryMonitor::AdcBatteryMonitor(adc_unit_t adc_unit, adc_channel_t adc_channel, float upper_resistor, float lower_resistor, gpio_num_t charging_pin)
     : charging_pin_(charging_pin) {
@@ -112,5 +113,12 @@ void AdcBatteryMonitor::CheckBatteryStatus() {
         if (on_charging_status_changed_) {
             on_charging_status_changed_(is_charging_);
         }
+        Application::GetInstance().NotifyStatusChanged();
+    }
+
+    uint8_t battery_level = GetBatteryLevel();
+    if (battery_level != battery_level_) {
+        battery_level_ = battery_level;
+        Application::GetInstance().NotifyStatusChanged();
     }
 }
\ No newline at end of file
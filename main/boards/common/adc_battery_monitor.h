@@ -22,6 +22,7 @@ private:
     adc_battery_estimation_handle_t adc_battery_estimation_handle_ = nullptr;
     esp_timer_handle_t timer_handle_ = nullptr;
     bool is_charging_ = false;
+    uint8_t battery_level_ = 0;
     std::function<void(bool)> on_charging_status_changed_;
 
     void CheckBatteryStatus();
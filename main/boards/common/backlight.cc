@@ -1,5 +1,6 @@
 #include "backlight.h"
 #include "settings.h"
+#include "mcp_server.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -59,6 +60,7 @@ void Backlight::SetBrightness(uint8_t brightness, bool permanent) {
 
     target_brightness_ = brightness;
     step_ = (target_brightness_ > brightness_) ? 1 : -1;
+    McpServer::GetInstance().InvalidateCache(kMcpCacheKeyScreen);
 
     if (transition_timer_ != nullptr) {
         // 启动定时器，每 5ms 更新一次
@@ -78,6 +80,8 @@ void Backlight::OnTransitionTimer() {
 
     if (brightness_ == target_brightness_) {
         esp_timer_stop(transition_timer_);
+        // The reported brightness has settled
+        McpServer::GetInstance().InvalidateCache(kMcpCacheKeyScreen);
     }
 }
 
@@ -1,6 +1,7 @@
 #include "board.h"
 #include "system_info.h"
 #include "settings.h"
+#include "boot_timeline.h"
 #include "display/display.h"
 #include "display/oled_display.h"
 #include "assets/lang_config.h"
@@ -102,6 +103,9 @@ std::string Board::GetSystemInfoJson() {
             "ota": {
                 "label": "ota_0"
             },
+            "boot_timeline": [
+                {"name": "board", "start_ms": 120, "duration_ms": 310}
+            ],
             "board": {
                 ...
             }
@@ -170,6 +174,8 @@ std::string Board::GetSystemInfoJson() {
     }
     json += R"(},)";
 
+    json += R"("boot_timeline":)" + BootTimeline::GetInstance().GetJson() + R"(,)";
+
     json += R"("board":)" + GetBoardJson();
 
     // Close the JSON object
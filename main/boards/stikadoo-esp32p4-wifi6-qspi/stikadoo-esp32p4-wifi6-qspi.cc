@@ -17,6 +17,7 @@
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <mutex>
 
 #define TAG "StikadooEsp32p4Wifi6Qspi"
 #define LCD_OPCODE_WRITE_CMD (0x02ULL)
@@ -97,6 +98,7 @@ private:
     LcdDisplay *display_;
     CustomBacklight *backlight_;
     ThermalPrinter *thermal_printer_ = nullptr;
+    std::once_flag thermal_printer_once_;
 
     void HandleBootButtonDelayedListenStart() {
         if (!boot_button_down_ || listening_started_by_button_) {
@@ -251,7 +253,6 @@ public:
         InitializeSpi();
         InitializeLCD();
         InitializeButtons();
-        InitializeThermalPrinter();
     }
 
     virtual AudioCodec *GetAudioCodec() override {
@@ -268,6 +269,8 @@ public:
      }
 
     virtual ThermalPrinter *GetThermalPrinter() override {
+        // The printer is only brought up when something first prints, it is not needed to boot
+        std::call_once(thermal_printer_once_, [this]() { InitializeThermalPrinter(); });
         return thermal_printer_;
     }
 
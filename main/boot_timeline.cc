@@ -0,0 +1,102 @@
+#include "boot_timeline.h"
+
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "BootTimeline"
+
+BootTimeline::Phase* BootTimeline::Find(const char* name) {
+    for (int i = 0; i < count_; i++) {
+        if (strcmp(phases_[i].name, name) == 0) {
+            return &phases_[i];
+        }
+    }
+    return nullptr;
+}
+
+void BootTimeline::Begin(const char* name) {
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == kMaxPhases || Find(name) != nullptr) {
+        return;
+    }
+    phases_[count_++] = Phase{name, now, 0};
+}
+
+void BootTimeline::End(const char* name) {
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto phase = Find(name);
+    if (phase != nullptr && phase->end_us == 0) {
+        phase->end_us = std::max(now, phase->start_us + 1);
+    }
+}
+
+void BootTimeline::Mark(const char* name) {
+    uint32_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ == kMaxPhases || Find(name) != nullptr) {
+        return;
+    }
+    phases_[count_++] = Phase{name, now, now};
+}
+
+void BootTimeline::PrintWaterfall() {
+    const int kBarWidth = 40;
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t total_us = 1;
+    for (int i = 0; i < count_; i++) {
+        total_us = std::max(total_us, std::max(phases_[i].start_us, phases_[i].end_us));
+    }
+
+    printf("| Phase            | %-*s | Start ms | Duration ms\n", kBarWidth, "");
+    for (int i = 0; i < count_; i++) {
+        const auto& phase = phases_[i];
+        char bar[kBarWidth + 1];
+        memset(bar, ' ', kBarWidth);
+        bar[kBarWidth] = '\0';
+        int from = (uint64_t)phase.start_us * kBarWidth / total_us;
+        int to = phase.end_us == 0 ? kBarWidth : (uint64_t)phase.end_us * kBarWidth / total_us;
+        from = std::min(from, kBarWidth - 1);
+        to = std::max(std::min(to, kBarWidth), from + 1);
+        if (phase.end_us == phase.start_us) {
+            bar[from] = '|';
+        } else {
+            memset(bar + from, '#', to - from);
+        }
+        if (phase.end_us == 0) {
+            printf("| %-16s | %s | %8lu | running\n", phase.name, bar, phase.start_us / 1000);
+        } else {
+            printf("| %-16s | %s | %8lu | %8lu\n", phase.name, bar, phase.start_us / 1000,
+                (phase.end_us - phase.start_us) / 1000);
+        }
+    }
+
+#if CONFIG_BOOT_TIME_BUDGET_MS > 0
+    if (total_us / 1000 > CONFIG_BOOT_TIME_BUDGET_MS) {
+        ESP_LOGW(TAG, "Boot took %lu ms, over the budget of %d ms", total_us / 1000, CONFIG_BOOT_TIME_BUDGET_MS);
+    }
+#endif
+}
+
+std::string BootTimeline::GetJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string json = "[";
+    for (int i = 0; i < count_; i++) {
+        const auto& phase = phases_[i];
+        json += R"({"name":")" + std::string(phase.name) + R"(",)";
+        json += R"("start_ms":)" + std::to_string(phase.start_us / 1000);
+        if (phase.end_us != 0) {
+            json += R"(,"duration_ms":)" + std::to_string((phase.end_us - phase.start_us) / 1000);
+        }
+        json += R"(},)";
+    }
+    if (count_ > 0) {
+        json.pop_back(); // Remove the last comma
+    }
+    json += "]";
+    return json;
+}
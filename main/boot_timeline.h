@@ -0,0 +1,48 @@
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+/**
+ * Records when each startup phase begins and ends, relative to boot.
+ * Phase names must be string literals; a phase is only recorded the first
+ * time, so phases that may repeat (e.g. srmodel_load after an assets
+ * download) keep their boot-time value.
+ */
+class BootTimeline {
+public:
+    static constexpr int kMaxPhases = 24;
+
+    static BootTimeline& GetInstance() {
+        static BootTimeline instance;
+        return instance;
+    }
+
+    void Begin(const char* name);
+    void End(const char* name);
+    // A phase without duration, e.g. the first time the device starts listening
+    void Mark(const char* name);
+
+    // Print the phases as a waterfall, and warn if the boot budget is exceeded
+    void PrintWaterfall();
+    // [{"name":"board","start_ms":12,"duration_ms":310},...]
+    std::string GetJson();
+
+private:
+    struct Phase {
+        const char* name;
+        uint32_t start_us;
+        uint32_t end_us;  // 0 while the phase is running
+    };
+
+    std::mutex mutex_;
+    Phase phases_[kMaxPhases];
+    int count_ = 0;
+
+    BootTimeline() = default;
+    Phase* Find(const char* name);
+};
+
+#endif // BOOT_TIMELINE_H
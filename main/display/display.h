@@ -35,6 +35,11 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Streams content into the current message of role, e.g. the sentences of a reply.
+    // SetChatMessage or EndChatStream ends the stream; by default every call replaces the message.
+    virtual void AppendChatMessage(const char* role, const char* content);
+    // The next AppendChatMessage starts a new message, the current one stays on screen
+    virtual void EndChatStream() {}
     virtual void SetTheme(Theme* theme);
     virtual Theme* GetTheme() { return current_theme_; }
     virtual void UpdateStatusBar(bool update_all = false);
@@ -419,15 +419,43 @@ void LcdDisplay::SetupUI() {
     // Enable scrolling for chat content
     lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_scroll_dir(content_, LV_DIR_VER);
-    
-    // Create a flex container for chat messages
-    lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
-    lv_obj_set_style_pad_row(content_, lvgl_theme->spacing(4), 0); // Space between messages
+
+    // Messages are placed by LayoutChatMessages, the bubbles in view are bound while scrolling
+    lv_obj_set_style_layout(content_, LV_LAYOUT_NONE, 0);
+    lv_obj_add_event_cb(content_, [](lv_event_t* e) {
+        auto display = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        display->UpdateChatRows();
+    }, LV_EVENT_SCROLL, this);
+
+    // Keeps the scrollable height of the whole history while only some bubbles exist
+    chat_spacer_ = lv_obj_create(content_);
+    lv_obj_remove_style_all(chat_spacer_);
+    lv_obj_set_size(chat_spacer_, 1, 1);
+    lv_obj_remove_flag(chat_spacer_, LV_OBJ_FLAG_CLICKABLE);
 
     // We'll create chat messages dynamically in SetChatMessage
     chat_message_label_ = nullptr;
 
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    auto render_event_cb = [](lv_event_t* e) {
+        auto display = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        if (!display->chat_render_pending_) {
+            return;
+        }
+        auto now = esp_timer_get_time();
+        if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+            display->chat_render_start_us_ = now;
+        } else if (display->chat_render_start_us_ != 0) {
+            ESP_LOGI(TAG, "Chat messages: %u, bubbles: %u, update: %d us, render: %d us", display->chat_messages_.size(),
+                display->chat_rows_.size(), int(display->chat_update_us_), int(now - display->chat_render_start_us_));
+            display->chat_render_pending_ = false;
+            display->chat_render_start_us_ = 0;
+        }
+    };
+    lv_display_add_event_cb(display_, render_event_cb, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, render_event_cb, LV_EVENT_RENDER_READY, this);
+#endif
+
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, text_font->line_height * 2);
@@ -450,49 +478,42 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 }
+
+LcdDisplay::ChatRole LcdDisplay::GetChatRole(const char* role) {
+    if (strcmp(role, "user") == 0) {
+        return kChatRoleUser;
+    } else if (strcmp(role, "system") == 0) {
+        return kChatRoleSystem;
+    }
+    return kChatRoleAssistant;
+}
+
+// Only the history is limited by this, bubble objects exist for the messages in view.
+// Preview bitmaps are kept for the newest MAX_IMAGE_MESSAGES images only, below what
+// the old limit of 40 / 20 messages could hold.
 #if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
+#define  MAX_MESSAGES 100
+#define  MAX_IMAGE_MESSAGES 8
 #else
-#define  MAX_MESSAGES 20
+#define  MAX_MESSAGES 50
+#define  MAX_IMAGE_MESSAGES 4
 #endif
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
         return;
     }
-    
-    // Check if message count exceeds limit
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // Delete the oldest message (first child object)
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    auto start_time = esp_timer_get_time();
+#endif
+
+    chat_streaming_ = false;
+    ChatRole chat_role = GetChatRole(role);
+
     // Collapse system messages (if it's a system message, check if the last message is also a system message)
-    if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // Get the last message container
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // Get the bubble inside the container
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // Check if bubble type is system message
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // If the last message is also a system message, delete it
-                        lv_obj_del(last_container);
-                    }
-                }
-            }
+    if (chat_role == kChatRoleSystem) {
+        if (!chat_messages_.empty() && chat_messages_.back().role == kChatRoleSystem) {
+            RemoveChatMessage(false);
         }
     } else {
         // Hide the centered AI logo
@@ -500,147 +521,317 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     }
 
     // Avoid empty message boxes
-    if(strlen(content) == 0) {
+    if (strlen(content) == 0) {
+        LayoutChatMessages();
+        UpdateChatRows();
         return;
     }
 
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    auto text_font = lvgl_theme->text_font()->font();
+    AddChatMessage(ChatMessage{.id = 0, .role = chat_role, .text = content});
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    chat_update_us_ = esp_timer_get_time() - start_time;
+    chat_render_pending_ = true;
+#endif
+}
 
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
+void LcdDisplay::EndChatStream() {
+    DisplayLockGuard lock(this);
+    chat_streaming_ = false;
+}
 
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // Calculate actual text width
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
+void LcdDisplay::AppendChatMessage(const char* role, const char* content) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        return;
+    }
+    if (!chat_streaming_ || chat_messages_.empty() || chat_messages_.back().role != GetChatRole(role)) {
+        SetChatMessage(role, content);
+        chat_streaming_ = !chat_messages_.empty();
+        return;
+    }
+    if (strlen(content) == 0) {
+        return;
+    }
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    auto start_time = esp_timer_get_time();
+#endif
 
-    // Calculate bubble width
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // Ensure text width is not less than minimum width
-    if (text_width < min_width) {
-        text_width = min_width;
+    auto& message = chat_messages_.back();
+    int32_t old_width = message.width;
+    int32_t old_height = message.height;
+    // Sentences of latin scripts are separated by a space, CJK text is joined as is
+    if (!message.text.empty() && (uint8_t)message.text.back() < 0x80 && message.text.back() != ' ' &&
+        (uint8_t)content[0] < 0x80 && content[0] != ' ') {
+        message.text += ' ';
+    }
+    message.text += content;
+    MeasureChatMessage(message);
+    LayoutChatMessages();
+
+    auto row = FindChatRow(message.id);
+    if (row != nullptr) {
+        // The lines above the last one keep their pixels while the bubble only grows downwards,
+        // so the redraw is limited to the last line and the new ones
+        bool grows_down = message.width == old_width;
+        if (grows_down) {
+            lv_display_enable_invalidation(display_, false);
+        }
+        lv_obj_set_size(row->bubble, message.width, message.height);
+        lv_obj_set_width(row->label, message.text_width);
+        lv_label_set_text(row->label, message.text.c_str());
+        lv_obj_update_layout(content_);
+        if (grows_down) {
+            lv_display_enable_invalidation(display_, true);
+            auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+            lv_area_t area;
+            lv_obj_get_coords(row->bubble, &area);
+            area.y1 += old_height - lvgl_theme->spacing(4) - lvgl_theme->text_font()->font()->line_height;
+            lv_obj_invalidate_area(row->bubble, &area);
+        }
     }
 
-    // If text width is less than max width, use text width
-    if (text_width < max_width) {
-        bubble_width = text_width; 
+    // Follow the message only when it runs past the bottom of the chat area
+    if (message.y + message.height > lv_obj_get_scroll_y(content_) + lv_obj_get_content_height(content_)) {
+        lv_obj_update_layout(content_);
+        lv_obj_scroll_to_y(content_, chat_height_, LV_ANIM_ON);
+    }
+    UpdateChatRows();
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    chat_update_us_ = esp_timer_get_time() - start_time;
+    chat_render_pending_ = true;
+#endif
+}
+
+void LcdDisplay::AddChatMessage(ChatMessage&& message) {
+    if (chat_messages_.size() >= MAX_MESSAGES) {
+        RemoveChatMessage(true);
+    }
+    message.id = chat_next_id_++;
+    MeasureChatMessage(message);
+    bool is_image = message.role == kChatRoleImage;
+    chat_messages_.push_back(std::move(message));
+    if (is_image) {
+        ReleaseOldImages();
+    }
+    // The content width is known once the screen is laid out
+    lv_obj_update_layout(content_);
+    LayoutChatMessages();
+
+    // Auto-scroll to the new message
+    lv_obj_update_layout(content_);
+    lv_obj_scroll_to_y(content_, chat_height_, LV_ANIM_ON);
+    UpdateChatRows();
+}
+
+void LcdDisplay::RemoveChatMessage(bool oldest) {
+    auto& message = oldest ? chat_messages_.front() : chat_messages_.back();
+    auto row = FindChatRow(message.id);
+    if (row != nullptr) {
+        UnbindChatRow(*row);
+    }
+    if (oldest) {
+        chat_messages_.pop_front();
     } else {
-        bubble_width = max_width;
+        chat_messages_.pop_back();
+        chat_next_id_--;
     }
-    
-    // Set message text width
-    lv_obj_set_width(msg_text, bubble_width);  // Subtract padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
+}
 
-    // Set bubble width
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+// Frees the bitmaps of all but the newest MAX_IMAGE_MESSAGES images. The message keeps
+// its size, so the history does not move, and shows an empty bubble.
+void LcdDisplay::ReleaseOldImages() {
+    int images = 0;
+    for (auto it = chat_messages_.rbegin(); it != chat_messages_.rend(); ++it) {
+        if (it->role != kChatRoleImage || it->image == nullptr) {
+            continue;
+        }
+        if (++images <= MAX_IMAGE_MESSAGES) {
+            continue;
+        }
+        auto row = FindChatRow(it->id);
+        if (row != nullptr) {
+            UnbindChatRow(*row);
+        }
+        it->image.reset();
+    }
+}
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // Set custom attribute to mark bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+// Computes the bubble size without creating objects
+void LcdDisplay::MeasureChatMessage(ChatMessage& message) {
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    if (message.role == kChatRoleImage) {
+        if (message.image == nullptr) {
+            return;  // Released, the size measured with the image is kept
+        }
+        lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
+        lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
+        auto img_dsc = message.image->image_dsc();
+        lv_coord_t img_width = img_dsc->header.w;
+        lv_coord_t img_height = img_dsc->header.h;
+        if (img_width == 0 || img_height == 0) {
+            img_width = max_width;
+            img_height = max_height;
+            ESP_LOGW(TAG, "Invalid image dimensions: %ld x %ld, using default dimensions: %ld x %ld", img_width, img_height, max_width, max_height);
+        }
+
+        // Zoom to fit within maximum dimensions, but not above 256 (100%)
+        lv_coord_t zoom = std::min(std::min((max_width * 256) / img_width, (max_height * 256) / img_height), (lv_coord_t)256);
+        message.image_scale = zoom;
+        // The bubble is 16 pixels larger than the image (8 pixels on each side)
+        message.width = (img_width * zoom) / 256 + 16;
+        message.height = (img_height * zoom) / 256 + 16;
+        return;
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // Create full-width container for system messages to ensure center alignment
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        lv_obj_set_parent(msg_bubble, container);
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+
+    auto text_font = lvgl_theme->text_font()->font();
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
+    lv_coord_t min_width = 20;
+    lv_coord_t text_width = lv_txt_get_width(message.text.c_str(), message.text.size(), text_font, 0);
+    message.text_width = std::max(min_width, std::min(text_width, max_width));
+
+    lv_point_t text_size;
+    lv_txt_get_size(&text_size, message.text.c_str(), text_font, 0, 0, message.text_width, LV_TEXT_FLAG_NONE);
+    message.width = message.text_width + 2 * lvgl_theme->spacing(4);
+    message.height = text_size.y + 2 * lvgl_theme->spacing(4);
+}
+
+void LcdDisplay::LayoutChatMessages() {
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    int32_t row_gap = lvgl_theme->spacing(4);  // Space between messages
+    int32_t content_width = lv_obj_get_content_width(content_);
+    int32_t y = 0;
+    for (auto& message : chat_messages_) {
+        if (message.role == kChatRoleUser) {
+            message.x = content_width - message.width;
+        } else if (message.role == kChatRoleSystem) {
+            message.x = (content_width - message.width) / 2;
+        } else {
+            message.x = 0;
+        }
+        message.y = y;
+        y += message.height + row_gap;
+    }
+    chat_height_ = chat_messages_.empty() ? 0 : y - row_gap;
+    lv_obj_set_pos(chat_spacer_, 0, std::max(chat_height_ - 1, (int32_t)0));
+
+    // Bound bubbles follow their messages, e.g. after the oldest one was dropped
+    for (auto& row : chat_rows_) {
+        if (row.message_id != 0) {
+            const auto& message = chat_messages_[row.message_id - chat_messages_.front().id];
+            lv_obj_set_pos(row.bubble, message.x, message.y);
+        }
+    }
+}
+
+// Binds the messages within half a screen of the viewport to bubbles, releasing the others
+void LcdDisplay::UpdateChatRows() {
+    int32_t margin = LV_VER_RES / 2;
+    int32_t top = lv_obj_get_scroll_y(content_) - margin;
+    int32_t bottom = lv_obj_get_scroll_y(content_) + lv_obj_get_height(content_) + margin;
+    auto in_view = [top, bottom](const ChatMessage& message) {
+        return message.y + message.height > top && message.y < bottom;
+    };
+
+    for (auto& row : chat_rows_) {
+        if (row.message_id != 0 && !in_view(chat_messages_[row.message_id - chat_messages_.front().id])) {
+            UnbindChatRow(row);
+        }
+    }
+
+    for (const auto& message : chat_messages_) {
+        if (!in_view(message)) {
+            continue;
+        }
+        if (FindChatRow(message.id) != nullptr) {
+            continue;
+        }
+
+        auto free_row = FindChatRow(0);
+        if (free_row == nullptr) {
+            auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+            lv_obj_t* bubble = lv_obj_create(content_);
+            lv_obj_set_style_radius(bubble, 8, 0);
+            lv_obj_set_scrollbar_mode(bubble, LV_SCROLLBAR_MODE_OFF);
+            lv_obj_remove_flag(bubble, LV_OBJ_FLAG_SCROLLABLE);
+            lv_obj_set_style_border_width(bubble, 0, 0);
+            lv_obj_set_style_pad_all(bubble, lvgl_theme->spacing(4), 0);
+            lv_obj_set_style_bg_opa(bubble, LV_OPA_70, 0);
+
+            lv_obj_t* label = lv_label_create(bubble);
+            lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+            lv_obj_t* image = lv_image_create(bubble);
+            lv_obj_add_flag(image, LV_OBJ_FLAG_HIDDEN);
+
+            chat_rows_.push_back(ChatRow{bubble, label, image, 0});
+            free_row = &chat_rows_.back();
+        }
+        BindChatRow(*free_row, message);
+    }
+}
+
+LcdDisplay::ChatRow* LcdDisplay::FindChatRow(uint32_t message_id) {
+    for (auto& row : chat_rows_) {
+        if (row.message_id == message_id) {
+            return &row;
+        }
+    }
+    return nullptr;
+}
+
+void LcdDisplay::BindChatRow(ChatRow& row, const ChatMessage& message) {
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    row.message_id = message.id;
+    lv_obj_set_pos(row.bubble, message.x, message.y);
+    lv_obj_set_size(row.bubble, message.width, message.height);
+
+    if (message.role == kChatRoleImage) {
+        lv_obj_set_style_bg_color(row.bubble, lvgl_theme->assistant_bubble_color(), 0);
+        lv_obj_add_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+        if (message.image != nullptr) {
+            lv_obj_remove_flag(row.image, LV_OBJ_FLAG_HIDDEN);
+            lv_image_set_src(row.image, message.image->image_dsc());
+            lv_image_set_scale(row.image, message.image_scale);
+            lv_obj_center(row.image);
+        }
     } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        lv_color_t bubble_color = lvgl_theme->assistant_bubble_color();
+        lv_color_t text_color = lvgl_theme->text_color();
+        if (message.role == kChatRoleUser) {
+            bubble_color = lvgl_theme->user_bubble_color();
+        } else if (message.role == kChatRoleSystem) {
+            bubble_color = lvgl_theme->system_bubble_color();
+            text_color = lvgl_theme->system_text_color();
+        }
+        lv_obj_set_style_bg_color(row.bubble, bubble_color, 0);
+        lv_obj_set_style_text_color(row.label, text_color, 0);
+        lv_obj_set_width(row.label, message.text_width);
+        lv_label_set_text(row.label, message.text.c_str());
+        lv_obj_remove_flag(row.label, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_obj_remove_flag(row.bubble, LV_OBJ_FLAG_HIDDEN);
+}
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+void LcdDisplay::UnbindChatRow(ChatRow& row) {
+    row.message_id = 0;
+    lv_obj_add_flag(row.bubble, LV_OBJ_FLAG_HIDDEN);
+    // The image may be released with its message
+    if (!lv_obj_has_flag(row.image, LV_OBJ_FLAG_HIDDEN)) {
+        lv_obj_add_flag(row.image, LV_OBJ_FLAG_HIDDEN);
+        lv_image_set_src(row.image, nullptr);
     }
-    
-    // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+}
+
+// Bubbles are measured and styled with the current theme, so they are created again
+void LcdDisplay::RebuildChatRows() {
+    for (auto& row : chat_rows_) {
+        lv_obj_del(row.bubble);
+    }
+    chat_rows_.clear();
+    for (auto& message : chat_messages_) {
+        MeasureChatMessage(message);
+    }
+    LayoutChatMessages();
+    UpdateChatRows();
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -652,79 +843,9 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
     if (image == nullptr) {
         return;
     }
-    
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    // Create a message bubble for image preview
-    lv_obj_t* img_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(img_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(img_bubble, 0, 0);
-    lv_obj_set_style_pad_all(img_bubble, lvgl_theme->spacing(4), 0);
-    
-    // Set image bubble background color (similar to system message)
-    lv_obj_set_style_bg_color(img_bubble, lvgl_theme->assistant_bubble_color(), 0);
-    lv_obj_set_style_bg_opa(img_bubble, LV_OPA_70, 0);
-    
-    // Set custom attribute to mark bubble type
-    lv_obj_set_user_data(img_bubble, (void*)"image");
-
-    // Create the image object inside the bubble
-    lv_obj_t* preview_image = lv_image_create(img_bubble);
-    
-    // Calculate appropriate size for the image
-    lv_coord_t max_width = LV_HOR_RES * 70 / 100;  // 70% of screen width
-    lv_coord_t max_height = LV_VER_RES * 50 / 100; // 50% of screen height
-    
-    // Calculate zoom factor to fit within maximum dimensions
-    auto img_dsc = image->image_dsc();
-    lv_coord_t img_width = img_dsc->header.w;
-    lv_coord_t img_height = img_dsc->header.h;
-    if (img_width == 0 || img_height == 0) {
-        img_width = max_width;
-        img_height = max_height;
-        ESP_LOGW(TAG, "Invalid image dimensions: %ld x %ld, using default dimensions: %ld x %ld", img_width, img_height, max_width, max_height);
-    }
-    
-    lv_coord_t zoom_w = (max_width * 256) / img_width;
-    lv_coord_t zoom_h = (max_height * 256) / img_height;
-    lv_coord_t zoom = (zoom_w < zoom_h) ? zoom_w : zoom_h;
-    
-    // Ensure zoom doesn't exceed 256 (100%)
-    if (zoom > 256) zoom = 256;
-    
-    // Set image properties
-    lv_image_set_src(preview_image, img_dsc);
-    lv_image_set_scale(preview_image, zoom);
-    
-    // Add event handler to clean up LvglImage when image is deleted
-    // We need to transfer ownership of the unique_ptr to the event callback
-    LvglImage* raw_image = image.release(); // Release ownership of smart pointer
-    lv_obj_add_event_cb(preview_image, [](lv_event_t* e) {
-        LvglImage* img = (LvglImage*)lv_event_get_user_data(e);
-        if (img != nullptr) {
-            delete img; // Properly release memory by deleting LvglImage object
-        }
-    }, LV_EVENT_DELETE, (void*)raw_image);
-    
-    // Calculate actual scaled image dimensions
-    lv_coord_t scaled_width = (img_width * zoom) / 256;
-    lv_coord_t scaled_height = (img_height * zoom) / 256;
-    
-    // Set bubble size to be 16 pixels larger than the image (8 pixels on each side)
-    lv_obj_set_width(img_bubble, scaled_width + 16);
-    lv_obj_set_height(img_bubble, scaled_height + 16);
-    
-    // Don't grow in flex layout
-    lv_obj_set_style_flex_grow(img_bubble, 0, 0);
-    
-    // Center the image within the bubble
-    lv_obj_center(preview_image);
-    
-    // Left align the image bubble like assistant messages
-    lv_obj_align(img_bubble, LV_ALIGN_LEFT_MID, 0, 0);
 
-    // Auto-scroll to the image bubble
-    lv_obj_scroll_to_view_recursive(img_bubble, LV_ANIM_ON);
+    // Left aligned like assistant messages, the image is kept with the message
+    AddChatMessage(ChatMessage{.id = 0, .role = kChatRoleImage, .text = "", .image = std::move(image)});
 }
 #else
 void LcdDisplay::SetupUI() {
@@ -901,6 +1022,18 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     // Force the center widget to stay as the Stikadoo button (no emoji popups).
     DisplayLockGuard lock(this);
 
+    // The same emotion is set for every sentence, skip it before touching any object
+    std::shared_ptr<EmojiCollection> emoji_collection;
+    if (current_theme_ != nullptr) {
+        emoji_collection = static_cast<LvglTheme*>(current_theme_)->emoji_collection();
+    }
+    int emotion_id = emoji_collection != nullptr ? emoji_collection->GetEmotionId(emotion) : -1;
+    if (emoji_collection.get() == emotion_collection_ && emotion_id == emotion_id_) {
+        return;
+    }
+    emotion_collection_ = emoji_collection.get();
+    emotion_id_ = emotion_id;
+
     // Stop and clear any running GIF/image so it never shows on boot.
     if (gif_controller_) {
         gif_controller_->Stop();
@@ -963,71 +1096,6 @@ void LcdDisplay::SetTheme(Theme* theme) {
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     // Set content background opacity
     lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
-
-    // Iterate through all children of content (message containers or bubbles)
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    for (uint32_t i = 0; i < child_count; i++) {
-        lv_obj_t* obj = lv_obj_get_child(content_, i);
-        if (obj == nullptr) continue;
-        
-        lv_obj_t* bubble = nullptr;
-        
-        // Check if this object is a container or bubble
-        // If it's a container (user or system message), get its child as bubble
-        // If it's a bubble (assistant message), use it directly
-        if (lv_obj_get_child_cnt(obj) > 0) {
-            // Might be a container, check if it's a user or system message container
-            // User and system message containers are transparent
-            lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-            if (bg_opa == LV_OPA_TRANSP) {
-                // This is a user or system message container
-                bubble = lv_obj_get_child(obj, 0);
-            } else {
-                // This might be an assistant message bubble itself
-                bubble = obj;
-            }
-        } else {
-            // No child elements, might be other UI elements, skip
-            continue;
-        }
-        
-        if (bubble == nullptr) continue;
-        
-        // Use saved user data to identify bubble type
-        void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-        if (bubble_type_ptr != nullptr) {
-            const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-            
-            // Apply correct color based on bubble type
-            if (strcmp(bubble_type, "user") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->user_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "assistant") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->assistant_bubble_color(), 0); 
-            } else if (strcmp(bubble_type, "system") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "image") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            }
-            
-            // Update border color
-            lv_obj_set_style_border_color(bubble, lvgl_theme->border_color(), 0);
-            
-            // Update text color for the message
-            if (lv_obj_get_child_cnt(bubble) > 0) {
-                lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                if (text != nullptr) {
-                    // Set text color based on bubble type
-                    if (strcmp(bubble_type, "system") == 0) {
-                        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
-                    } else {
-                        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
-                    }
-                }
-            }
-        } else {
-            ESP_LOGW(TAG, "child[%lu] Bubble type is not found", i);
-        }
-    }
 #else
     // Simple UI mode - just update the main chat message
     if (chat_message_label_ != nullptr) {
@@ -1055,6 +1123,10 @@ void LcdDisplay::SetTheme(Theme* theme) {
 
     // No errors occurred. Save theme to settings
     Display::SetTheme(lvgl_theme);
+
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    RebuildChatRows();
+#endif
 }
 
 void LcdDisplay::SetHideSubtitle(bool hide) {
@@ -9,9 +9,14 @@
 #include <font_emoji.h>
 #include <atomic>
 #include <memory>
+#include <deque>
+#include <string>
+#include <vector>
 
 #define PREVIEW_IMAGE_DURATION_MS 10000
 
+class EmojiCollection;
+
 class LcdDisplay : public LvglDisplay {
 protected:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
@@ -27,6 +32,8 @@ protected:
     lv_obj_t* emoji_label_ = nullptr;
     lv_obj_t* emoji_image_ = nullptr;
     std::unique_ptr<LvglGif> gif_controller_ = nullptr;
+    const EmojiCollection* emotion_collection_ = nullptr;  // The ids of emotion_id_ belong to this collection
+    int emotion_id_ = -2;  // Id of the emotion shown, -1 is an unknown emotion
     lv_obj_t* emoji_box_ = nullptr;
     lv_obj_t* chat_message_label_ = nullptr;
     std::unique_ptr<StikadooUI> stikadoo_ui_ = nullptr;
@@ -34,8 +41,57 @@ protected:
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
     bool hide_subtitle_ = false;  // Control whether to hide chat messages/subtitles
 
+    // WeChat message style: the history is kept as data and only the messages in view
+    // are bound to the recycled bubble objects in chat_rows_
+    enum ChatRole : uint8_t {
+        kChatRoleUser,
+        kChatRoleAssistant,
+        kChatRoleSystem,
+        kChatRoleImage,
+    };
+    struct ChatMessage {
+        uint32_t id;  // Consecutive in chat_messages_
+        ChatRole role;
+        std::string text;
+        std::shared_ptr<LvglImage> image;  // Released for all but the newest images
+        uint16_t image_scale = LV_SCALE_NONE;
+        int32_t text_width = 0;
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+    };
+    struct ChatRow {
+        lv_obj_t* bubble;
+        lv_obj_t* label;
+        lv_obj_t* image;
+        uint32_t message_id;  // 0 when the row is free
+    };
+    std::deque<ChatMessage> chat_messages_;
+    std::vector<ChatRow> chat_rows_;
+    lv_obj_t* chat_spacer_ = nullptr;
+    uint32_t chat_next_id_ = 1;
+    int32_t chat_height_ = 0;
+    bool chat_streaming_ = false;  // AppendChatMessage extends the last message
+#if CONFIG_LCD_CHAT_RENDER_STATS
+    int64_t chat_update_us_ = 0;
+    int64_t chat_render_start_us_ = 0;
+    bool chat_render_pending_ = false;
+#endif
+
     void InitializeLcdThemes();
     void SetupUI();
+    void AddChatMessage(ChatMessage&& message);
+    void RemoveChatMessage(bool oldest);
+    void ReleaseOldImages();
+    void MeasureChatMessage(ChatMessage& message);
+    void LayoutChatMessages();
+    void UpdateChatRows();
+    void BindChatRow(ChatRow& row, const ChatMessage& message);
+    void UnbindChatRow(ChatRow& row);
+    void RebuildChatRows();
+    ChatRow* FindChatRow(uint32_t message_id);
+    static ChatRole GetChatRole(const char* role);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -48,6 +104,10 @@ public:
     virtual void SetStatus(const char* status) override;
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetChatMessage(const char* role, const char* content) override; 
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    virtual void AppendChatMessage(const char* role, const char* content) override;
+    virtual void EndChatStream() override;
+#endif
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image) override;
 
     // Add theme switching function
@@ -1,30 +1,63 @@
 #include "emoji_collection.h"
 
 #include <esp_log.h>
-#include <unordered_map>
-#include <string>
+#include <cstring>
 
 #define TAG "EmojiCollection"
 
-void EmojiCollection::AddEmoji(const std::string& name, LvglImage* image) {
-    emoji_collection_[name] = image;
+int EmojiCollection::GetEmotionId(const char* name) const {
+    if (name == nullptr) {
+        return -1;
+    }
+    auto it = ids_.find(name);
+    return it == ids_.end() ? -1 : it->second;
+}
+
+void EmojiCollection::SetImage(const std::string& name, const lv_img_dsc_t& image_dsc) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) {
+        images_[it->second] = image_dsc;
+        return;
+    }
+    ids_.emplace(name, images_.size());
+    images_.push_back(image_dsc);
+}
+
+void EmojiCollection::AddEmoji(const std::string& name, const lv_img_dsc_t* image_dsc) {
+    SetImage(name, *image_dsc);
+}
+
+void EmojiCollection::AddEmoji(const std::string& name, const void* data, size_t size) {
+    // Same descriptor as LvglRawImage, the decoder reads the size from the file
+    lv_img_dsc_t image_dsc = {};
+    image_dsc.data_size = size;
+    image_dsc.data = static_cast<const uint8_t*>(data);
+    image_dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    image_dsc.header.cf = LV_COLOR_FORMAT_RAW_ALPHA;
+    SetImage(name, image_dsc);
 }
 
-const LvglImage* EmojiCollection::GetEmojiImage(const char* name) {
-    auto it = emoji_collection_.find(name);
-    if (it != emoji_collection_.end()) {
-        return it->second;
+const lv_img_dsc_t* EmojiCollection::GetEmojiImage(int id) const {
+    if (id < 0 || id >= (int)images_.size()) {
+        return nullptr;
     }
+    return &images_[id];
+}
 
-    ESP_LOGW(TAG, "Emoji not found: %s", name);
-    return nullptr;
+const lv_img_dsc_t* EmojiCollection::GetEmojiImage(const char* name) const {
+    auto image_dsc = GetEmojiImage(GetEmotionId(name));
+    if (image_dsc == nullptr) {
+        ESP_LOGW(TAG, "Emoji not found: %s", name);
+    }
+    return image_dsc;
 }
 
-EmojiCollection::~EmojiCollection() {
-    for (auto it = emoji_collection_.begin(); it != emoji_collection_.end(); ++it) {
-        delete it->second;
+bool EmojiCollection::IsGif(int id) const {
+    auto image_dsc = GetEmojiImage(id);
+    if (image_dsc == nullptr || image_dsc->header.cf != LV_COLOR_FORMAT_RAW_ALPHA || image_dsc->data_size < 3) {
+        return false;
     }
-    emoji_collection_.clear();
+    return memcmp(image_dsc->data, "GIF", 3) == 0;
 }
 
 // These are declared in xiaozhi-fonts/src/font_emoji_32.c
@@ -51,27 +84,27 @@ extern const lv_image_dsc_t emoji_1f61c_32; // silly
 extern const lv_image_dsc_t emoji_1f644_32; // confused
 
 Twemoji32::Twemoji32() {
-    AddEmoji("neutral", new LvglSourceImage(&emoji_1f636_32));
-    AddEmoji("happy", new LvglSourceImage(&emoji_1f642_32));
-    AddEmoji("laughing", new LvglSourceImage(&emoji_1f606_32));
-    AddEmoji("funny", new LvglSourceImage(&emoji_1f602_32));
-    AddEmoji("sad", new LvglSourceImage(&emoji_1f614_32));
-    AddEmoji("angry", new LvglSourceImage(&emoji_1f620_32));
-    AddEmoji("crying", new LvglSourceImage(&emoji_1f62d_32));
-    AddEmoji("loving", new LvglSourceImage(&emoji_1f60d_32));
-    AddEmoji("embarrassed", new LvglSourceImage(&emoji_1f633_32));
-    AddEmoji("surprised", new LvglSourceImage(&emoji_1f62f_32));
-    AddEmoji("shocked", new LvglSourceImage(&emoji_1f631_32));
-    AddEmoji("thinking", new LvglSourceImage(&emoji_1f914_32));
-    AddEmoji("winking", new LvglSourceImage(&emoji_1f609_32));
-    AddEmoji("cool", new LvglSourceImage(&emoji_1f60e_32));
-    AddEmoji("relaxed", new LvglSourceImage(&emoji_1f60c_32));
-    AddEmoji("delicious", new LvglSourceImage(&emoji_1f924_32));
-    AddEmoji("kissy", new LvglSourceImage(&emoji_1f618_32));
-    AddEmoji("confident", new LvglSourceImage(&emoji_1f60f_32));
-    AddEmoji("sleepy", new LvglSourceImage(&emoji_1f634_32));
-    AddEmoji("silly", new LvglSourceImage(&emoji_1f61c_32));
-    AddEmoji("confused", new LvglSourceImage(&emoji_1f644_32));
+    AddEmoji("neutral", &emoji_1f636_32);
+    AddEmoji("happy", &emoji_1f642_32);
+    AddEmoji("laughing", &emoji_1f606_32);
+    AddEmoji("funny", &emoji_1f602_32);
+    AddEmoji("sad", &emoji_1f614_32);
+    AddEmoji("angry", &emoji_1f620_32);
+    AddEmoji("crying", &emoji_1f62d_32);
+    AddEmoji("loving", &emoji_1f60d_32);
+    AddEmoji("embarrassed", &emoji_1f633_32);
+    AddEmoji("surprised", &emoji_1f62f_32);
+    AddEmoji("shocked", &emoji_1f631_32);
+    AddEmoji("thinking", &emoji_1f914_32);
+    AddEmoji("winking", &emoji_1f609_32);
+    AddEmoji("cool", &emoji_1f60e_32);
+    AddEmoji("relaxed", &emoji_1f60c_32);
+    AddEmoji("delicious", &emoji_1f924_32);
+    AddEmoji("kissy", &emoji_1f618_32);
+    AddEmoji("confident", &emoji_1f60f_32);
+    AddEmoji("sleepy", &emoji_1f634_32);
+    AddEmoji("silly", &emoji_1f61c_32);
+    AddEmoji("confused", &emoji_1f644_32);
 }
 
 
@@ -99,25 +132,25 @@ extern const lv_image_dsc_t emoji_1f61c_64; // silly
 extern const lv_image_dsc_t emoji_1f644_64; // confused
 
 Twemoji64::Twemoji64() {
-    AddEmoji("neutral", new LvglSourceImage(&emoji_1f636_64));
-    AddEmoji("happy", new LvglSourceImage(&emoji_1f642_64));
-    AddEmoji("laughing", new LvglSourceImage(&emoji_1f606_64));
-    AddEmoji("funny", new LvglSourceImage(&emoji_1f602_64));
-    AddEmoji("sad", new LvglSourceImage(&emoji_1f614_64));
-    AddEmoji("angry", new LvglSourceImage(&emoji_1f620_64));
-    AddEmoji("crying", new LvglSourceImage(&emoji_1f62d_64));
-    AddEmoji("loving", new LvglSourceImage(&emoji_1f60d_64));
-    AddEmoji("embarrassed", new LvglSourceImage(&emoji_1f633_64));
-    AddEmoji("surprised", new LvglSourceImage(&emoji_1f62f_64));
-    AddEmoji("shocked", new LvglSourceImage(&emoji_1f631_64));
-    AddEmoji("thinking", new LvglSourceImage(&emoji_1f914_64));
-    AddEmoji("winking", new LvglSourceImage(&emoji_1f609_64));
-    AddEmoji("cool", new LvglSourceImage(&emoji_1f60e_64));
-    AddEmoji("relaxed", new LvglSourceImage(&emoji_1f60c_64));
-    AddEmoji("delicious", new LvglSourceImage(&emoji_1f924_64));
-    AddEmoji("kissy", new LvglSourceImage(&emoji_1f618_64));
-    AddEmoji("confident", new LvglSourceImage(&emoji_1f60f_64));
-    AddEmoji("sleepy", new LvglSourceImage(&emoji_1f634_64));
-    AddEmoji("silly", new LvglSourceImage(&emoji_1f61c_64));
-    AddEmoji("confused", new LvglSourceImage(&emoji_1f644_64));
+    AddEmoji("neutral", &emoji_1f636_64);
+    AddEmoji("happy", &emoji_1f642_64);
+    AddEmoji("laughing", &emoji_1f606_64);
+    AddEmoji("funny", &emoji_1f602_64);
+    AddEmoji("sad", &emoji_1f614_64);
+    AddEmoji("angry", &emoji_1f620_64);
+    AddEmoji("crying", &emoji_1f62d_64);
+    AddEmoji("loving", &emoji_1f60d_64);
+    AddEmoji("embarrassed", &emoji_1f633_64);
+    AddEmoji("surprised", &emoji_1f62f_64);
+    AddEmoji("shocked", &emoji_1f631_64);
+    AddEmoji("thinking", &emoji_1f914_64);
+    AddEmoji("winking", &emoji_1f609_64);
+    AddEmoji("cool", &emoji_1f60e_64);
+    AddEmoji("relaxed", &emoji_1f60c_64);
+    AddEmoji("delicious", &emoji_1f924_64);
+    AddEmoji("kissy", &emoji_1f618_64);
+    AddEmoji("confident", &emoji_1f60f_64);
+    AddEmoji("sleepy", &emoji_1f634_64);
+    AddEmoji("silly", &emoji_1f61c_64);
+    AddEmoji("confused", &emoji_1f644_64);
 }
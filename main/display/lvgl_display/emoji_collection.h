@@ -1,24 +1,39 @@
 #ifndef EMOJI_COLLECTION_H
 #define EMOJI_COLLECTION_H
 
-#include "lvgl_image.h"
-
 #include <lvgl.h>
 
-#include <map>
+#include <vector>
 #include <string>
-#include <memory>
+#include <unordered_map>
 
 
-// Define interface for emoji collection
+/**
+ * Emoji images indexed by emotion id. Emotion names are interned to small ids of
+ * this collection as emoji are added at theme load; the name map is read-only
+ * afterwards, so it is read without a lock. The image descriptors are kept by value
+ * in one vector; their data stays where it is, compiled into flash or in the
+ * mapped assets partition.
+ */
 class EmojiCollection {
 public:
-    virtual void AddEmoji(const std::string& name, LvglImage* image);
-    virtual const LvglImage* GetEmojiImage(const char* name);
-    virtual ~EmojiCollection();
+    // Returns the id of an emotion name, or -1 if the collection does not have it
+    int GetEmotionId(const char* name) const;
+
+    // Compiled-in image
+    virtual void AddEmoji(const std::string& name, const lv_img_dsc_t* image_dsc);
+    // PNG or GIF file data
+    virtual void AddEmoji(const std::string& name, const void* data, size_t size);
+    virtual const lv_img_dsc_t* GetEmojiImage(int id) const;
+    virtual const lv_img_dsc_t* GetEmojiImage(const char* name) const;
+    virtual bool IsGif(int id) const;
+    virtual ~EmojiCollection() = default;
 
 private:
-    std::map<std::string, LvglImage*> emoji_collection_;
+    std::unordered_map<std::string, int> ids_;
+    std::vector<lv_img_dsc_t> images_;  // Indexed by emotion id
+
+    void SetImage(const std::string& name, const lv_img_dsc_t& image_dsc);
 };
 
 class Twemoji32 : public EmojiCollection {
@@ -0,0 +1,101 @@
+#include "gif_frame_cache.h"
+
+#include <cstring>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "GifFrameCache"
+
+GifFrameCache::GifFrameCache(uint16_t width, uint16_t height, size_t budget)
+    : width_(width), height_(height), budget_(budget) {
+}
+
+GifFrameCache::~GifFrameCache() {
+    Release();
+}
+
+uint8_t* GifFrameCache::Allocate(size_t size) {
+    if (used_bytes_ + size > budget_) {
+        ESP_LOGI(TAG, "%ux%u GIF needs more than %u bytes to cache, decoding every frame", width_, height_, budget_);
+        Release();
+        return nullptr;
+    }
+    auto data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes for a GIF frame", size);
+        Release();
+        return nullptr;
+    }
+    used_bytes_ += size;
+    return data;
+}
+
+void GifFrameCache::Release() {
+    if (key_frame_ != nullptr) {
+        heap_caps_free(key_frame_);
+        key_frame_ = nullptr;
+    }
+    for (auto& frame : frames_) {
+        heap_caps_free(frame.data);
+    }
+    frames_.clear();
+    frames_.shrink_to_fit();
+    used_bytes_ = 0;
+    state_ = kDisabled;
+}
+
+void GifFrameCache::AddFrame(const uint8_t* canvas, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t delay,
+    bool loop_start) {
+    if (state_ == kWaiting) {
+        if (!loop_start) {
+            return;
+        }
+        size_t size = width_ * height_ * kPixelSize;
+        key_frame_ = Allocate(size);
+        if (key_frame_ != nullptr) {
+            memcpy(key_frame_, canvas, size);
+            key_frame_delay_ = delay;
+            state_ = kRecording;
+        }
+        return;
+    }
+    if (state_ != kRecording) {
+        return;
+    }
+
+    Frame frame = {x, y, w, h, delay, nullptr};
+    size_t row_size = w * kPixelSize;
+    if (w > 0 && h > 0) {
+        frame.data = Allocate(row_size * h);
+        if (frame.data == nullptr) {
+            return;
+        }
+        for (int row = 0; row < h; row++) {
+            memcpy(frame.data + row * row_size, canvas + ((y + row) * width_ + x) * kPixelSize, row_size);
+        }
+    }
+    frames_.push_back(frame);
+    // The frame returning to the start of the loop completes it
+    if (loop_start) {
+        state_ = kReady;
+        next_ = 0;
+        ESP_LOGD(TAG, "Cached %u frames of a %ux%u GIF in %u bytes", frame_count(), width_, height_, used_bytes_);
+    }
+}
+
+uint16_t GifFrameCache::NextFrame(uint8_t* canvas) {
+    const auto& frame = frames_[next_];
+    size_t row_size = frame.w * kPixelSize;
+    for (int row = 0; row < frame.h; row++) {
+        memcpy(canvas + ((frame.y + row) * width_ + frame.x) * kPixelSize, frame.data + row * row_size, row_size);
+    }
+    next_ = (next_ + 1) % frames_.size();
+    return frame.delay;
+}
+
+uint16_t GifFrameCache::Rewind(uint8_t* canvas) {
+    memcpy(canvas, key_frame_, width_ * height_ * kPixelSize);
+    // The first recorded rectangle follows the key frame
+    next_ = 0;
+    return key_frame_delay_;
+}
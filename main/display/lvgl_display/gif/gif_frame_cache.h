@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Decoded frames of an endlessly looping GIF, so later loops cost a copy of the
+ * rectangle each frame changed instead of decoding it. The first loop starts from
+ * the background and may differ, so the second loop is recorded: its first frame
+ * as a key frame for rewinding, then the changed rectangle of every frame including
+ * the return to the first one. The cache gives up and frees its memory once it
+ * would exceed its budget.
+ */
+class GifFrameCache {
+public:
+    GifFrameCache(uint16_t width, uint16_t height, size_t budget);
+    ~GifFrameCache();
+
+    // Records the canvas after a decoded frame, which may have changed the given rectangle
+    void AddFrame(const uint8_t* canvas, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t delay,
+        bool loop_start);
+    // Copies the next frame into canvas and returns its delay
+    uint16_t NextFrame(uint8_t* canvas);
+    // Copies the first frame of the loop into canvas and returns its delay
+    uint16_t Rewind(uint8_t* canvas);
+
+    inline bool ready() const { return state_ == kReady; }
+    inline bool disabled() const { return state_ == kDisabled; }
+    inline size_t used_bytes() const { return used_bytes_; }
+    // Frames per loop once the cache is ready
+    inline size_t frame_count() const { return frames_.size(); }
+
+private:
+    static constexpr int kPixelSize = 4;  // The canvas is ARGB8888
+
+    enum State {
+        kWaiting,
+        kRecording,
+        kReady,
+        kDisabled,
+    };
+    struct Frame {
+        uint16_t x, y, w, h;
+        uint16_t delay;
+        uint8_t* data;
+    };
+
+    uint16_t width_;
+    uint16_t height_;
+    size_t budget_;
+    State state_ = kWaiting;
+    uint8_t* key_frame_ = nullptr;
+    uint16_t key_frame_delay_ = 0;
+    std::vector<Frame> frames_;
+    size_t next_ = 0;
+    size_t used_bytes_ = 0;
+
+    uint8_t* Allocate(size_t size);
+    void Release();
+};
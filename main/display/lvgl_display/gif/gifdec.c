@@ -22,7 +22,7 @@ typedef struct Table {
     Entry * entries;
 } Table;
 
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_LZW_CACHE
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
 #define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
@@ -116,7 +116,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         ESP_LOGW(TAG, "Zero size image");
         goto fail;
     }
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_LZW_CACHE
     if(0 == (INT_MAX - sizeof(gd_GIF) - LZW_CACHE_SIZE) / width / height / 5){
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
@@ -145,7 +145,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
     bgcolor = &gif->palette->colors[gif->bgindex * 3];
-    #if LV_GIF_CACHE_DECODE_DATA
+    #if GIFDEC_LZW_CACHE
     gif->lzw_cache = gif->frame + width * height;
     #endif
 
@@ -328,7 +328,7 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
     return key;
 }
 
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_LZW_CACHE
 /* Decompress image pixels.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
@@ -386,14 +386,18 @@ read_image_data(gd_GIF *gif, int interlace)
     sp = p_stack;
 
     while (frm_off < frm_size) {
-        /* copy data to frame buffer */
+        /* copy data to frame buffer, up to the end of the row at a time */
         while (sp > p_stack) {
             if(frm_off >= frm_size){
                 ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
                 return -1;
             }
-            *ptr++ = *(--sp);
-            frm_off += 1;
+            int count = MIN(sp - p_stack, gif->fw - (ptr - ptr_row_start));
+            count = MIN(count, frm_size - frm_off);
+            frm_off += count;
+            while (count-- > 0) {
+                *ptr++ = *(--sp);
+            }
             /* read one line */
             if ((ptr - ptr_row_start) == gif->fw) {
                 if (interlace) {
@@ -668,21 +672,41 @@ render_frame_rect(gd_GIF * gif, uint8_t * buffer)
 #else
     int j, k;
     uint8_t index, * color;
+    uint8_t pixels[0x100][4];
+    const uint8_t * row;
+
+    /* Convert the palette once, so each pixel is a single 4 byte copy */
+    for(j = 0; j < gif->palette->size; j++) {
+        color = &gif->palette->colors[j * 3];
+        pixels[j][0] = *(color + 2);
+        pixels[j][1] = *(color + 1);
+        pixels[j][2] = *(color + 0);
+        pixels[j][3] = 0xFF;
+    }
+    for(; j < 0x100; j++) {
+        memset(pixels[j], 0, 4);
+        pixels[j][3] = 0xFF;
+    }
 
     for(j = 0; j < gif->fh; j++) {
-        for(k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index * 3];
-            if(!gif->gce.transparency || index != gif->gce.tindex) {
-                buffer[(i + k) * 4 + 0] = *(color + 2);
-                buffer[(i + k) * 4 + 1] = *(color + 1);
-                buffer[(i + k) * 4 + 2] = *(color + 0);
-                buffer[(i + k) * 4 + 3] = 0xFF;
+        row = &gif->frame[(gif->fy + j) * gif->width + gif->fx];
+        if(gif->gce.transparency) {
+            for(k = 0; k < gif->fw; k++) {
+                index = row[k];
+                if(index != gif->gce.tindex) {
+                    memcpy(&buffer[(i + k) * 4], pixels[index], 4);
+                }
+            }
+        }
+        else {
+            for(k = 0; k < gif->fw; k++) {
+                memcpy(&buffer[(i + k) * 4], pixels[row[k]], 4);
             }
         }
         i += gif->width;
     }
 #endif
+    if(buffer == gif->canvas) gif->rendered = 1;
 }
 
 static void
@@ -702,12 +726,10 @@ dispose(gd_GIF * gif)
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
 #else
             int j, k;
+            uint8_t pixel[4] = {*(bgcolor + 2), *(bgcolor + 1), *(bgcolor + 0), opa};
             for(j = 0; j < gif->fh; j++) {
                 for(k = 0; k < gif->fw; k++) {
-                    gif->canvas[(i + k) * 4 + 0] = *(bgcolor + 2);
-                    gif->canvas[(i + k) * 4 + 1] = *(bgcolor + 1);
-                    gif->canvas[(i + k) * 4 + 2] = *(bgcolor + 0);
-                    gif->canvas[(i + k) * 4 + 3] = opa;
+                    memcpy(&gif->canvas[(i + k) * 4], pixel, 4);
                 }
                 i += gif->width;
             }
@@ -716,8 +738,8 @@ dispose(gd_GIF * gif)
         case 3: /* Restore to previous, i.e., don't update canvas.*/
             break;
         default:
-            /* Add frame non-transparent pixels to canvas. */
-            render_frame_rect(gif, gif->canvas);
+            /* Add frame non-transparent pixels to canvas, unless gd_render_frame did. */
+            if(!gif->rendered) render_frame_rect(gif, gif->canvas);
     }
 }
 
@@ -744,6 +766,7 @@ gd_get_frame(gd_GIF * gif)
         else return -1;
         f_gif_read(gif, &sep, 1);
     }
+    gif->rendered = 0;
     if(read_image(gif) == -1)
         return -1;
     return 1;
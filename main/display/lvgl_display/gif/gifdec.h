@@ -9,6 +9,15 @@ extern "C" {
 
 #include <stdint.h>
 
+/* LZW codes are decoded with a preallocated code table and an output stack, several
+ * times faster than growing a table of strings and writing each string back to front.
+ * GIFDEC_TABLE_DECODER selects the table decoder, e.g. to compare them on the host. */
+#if LV_GIF_CACHE_DECODE_DATA || !defined(GIFDEC_TABLE_DECODER)
+#define GIFDEC_LZW_CACHE 1
+#else
+#define GIFDEC_LZW_CACHE 0
+#endif
+
 typedef struct _gd_Palette {
     int size;
     uint8_t colors[0x100 * 3];
@@ -46,7 +55,8 @@ typedef struct _gd_GIF {
     uint16_t fx, fy, fw, fh;
     uint8_t bgindex;
     uint8_t * canvas, * frame;
-#if LV_GIF_CACHE_DECODE_DATA
+    uint8_t rendered; /* The current frame is drawn on the canvas */
+#if GIFDEC_LZW_CACHE
     uint8_t *lzw_cache;
 #endif
 } gd_GIF;
@@ -1,9 +1,12 @@
 #include "lvgl_gif.h"
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
 
 #define TAG "LvglGif"
 
+#define GIF_FRAME_CACHE_SIZE (CONFIG_LVGL_GIF_FRAME_CACHE_SIZE_KB * 1024)
+
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
     if (!img_dsc || !img_dsc->data) {
@@ -106,6 +109,13 @@ void LvglGif::Stop() {
 
     if (gif_) {
         gd_rewind(gif_);
+        if (frame_cache_ && frame_cache_->ready()) {
+            frame_delay_ = frame_cache_->Rewind(gif_->canvas);
+        } else {
+            // A loop cut short is not recorded, start over with the next one
+            frame_cache_.reset();
+            frames_decoded_ = 0;
+        }
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
     }
@@ -132,6 +142,10 @@ void LvglGif::SetLoopCount(int32_t count) {
         return;
     }
     gif_->loop_count = count;
+    // Only endless loops are replayed from the cache
+    if (count != 0) {
+        frame_cache_.reset();
+    }
 }
 
 uint16_t LvglGif::width() const {
@@ -159,14 +173,23 @@ void LvglGif::NextFrame() {
 
     // Check if enough time has passed for the next frame
     uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
+    if (elapsed < frame_delay_ * 10) {
         return;
     }
 
     last_call_ = lv_tick_get();
 
+    // Loops after the second one are copied from the cache
+    if (frame_cache_ && frame_cache_->ready()) {
+        frame_delay_ = frame_cache_->NextFrame(gif_->canvas);
+        if (frame_callback_) {
+            frame_callback_();
+        }
+        return;
+    }
+
     // Get next frame
-    int has_next = gd_get_frame(gif_);
+    int has_next = DecodeFrame();
     if (has_next == 0) {
         // Animation finished, pause timer
         playing_ = false;
@@ -176,10 +199,8 @@ void LvglGif::NextFrame() {
         ESP_LOGD(TAG, "GIF animation completed");
     }
 
-    // Render current frame
+    // The frame is rendered on the canvas
     if (gif_->canvas) {
-        gd_render_frame(gif_, gif_->canvas);
-        
         // Call frame callback if set
         if (frame_callback_) {
             frame_callback_();
@@ -187,6 +208,45 @@ void LvglGif::NextFrame() {
     }
 }
 
+int LvglGif::DecodeFrame() {
+    // Disposing of the previous frame changes its rectangle
+    uint16_t x1 = gif_->fx, y1 = gif_->fy;
+    uint16_t x2 = gif_->fx + gif_->fw, y2 = gif_->fy + gif_->fh;
+
+    int has_next = gd_get_frame(gif_);
+    if (gif_->canvas) {
+        gd_render_frame(gif_, gif_->canvas);
+    }
+    frame_delay_ = gif_->gce.delay;
+    if (has_next != 1) {
+        frame_cache_.reset();
+        return has_next;
+    }
+
+    if (frames_decoded_++ == 0) {
+        // Every loop reads the frames from the same data, so a loop starts where the first frame ended
+        first_frame_end_ = gif_->f_rw_p;
+        if (gif_->loop_count == 0 && GIF_FRAME_CACHE_SIZE > 0) {
+            frame_cache_ = std::make_unique<GifFrameCache>(gif_->width, gif_->height, GIF_FRAME_CACHE_SIZE);
+        }
+        return has_next;
+    }
+
+    if (frame_cache_) {
+        if (gif_->fw > 0 && gif_->fh > 0) {
+            x1 = std::min(x1, gif_->fx);
+            y1 = std::min(y1, gif_->fy);
+            x2 = std::max<uint16_t>(x2, gif_->fx + gif_->fw);
+            y2 = std::max<uint16_t>(y2, gif_->fy + gif_->fh);
+        }
+        frame_cache_->AddFrame(gif_->canvas, x1, y1, x2 - x1, y2 - y1, frame_delay_, gif_->f_rw_p == first_frame_end_);
+        if (frame_cache_->disabled()) {
+            frame_cache_.reset();
+        }
+    }
+    return has_next;
+}
+
 void LvglGif::Cleanup() {
     // Stop and delete timer
     if (timer_) {
@@ -2,6 +2,7 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
@@ -81,6 +82,14 @@ private:
     
     // Last frame update time
     uint32_t last_call_;
+
+    // Delay of the current frame in 10 ms units
+    uint16_t frame_delay_ = 0;
+
+    // Decoded frames of endlessly looping GIFs, created after the first frame
+    std::unique_ptr<GifFrameCache> frame_cache_;
+    uint32_t frames_decoded_ = 0;
+    uint32_t first_frame_end_ = 0;
     
     // Animation state
     bool playing_;
@@ -93,6 +102,11 @@ private:
      * Update to next frame
      */
     void NextFrame();
+
+    /**
+     * Decode the next frame and record it in the frame cache
+     */
+    int DecodeFrame();
     
     /**
      * Cleanup resources
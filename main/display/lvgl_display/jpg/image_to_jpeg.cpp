@@ -465,3 +465,106 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+bool rgb565_strips_to_jpeg(uint16_t width, uint16_t height, bool big_endian, uint8_t quality,
+                           jpg_fill_cb fill, void* arg, uint8_t* out, size_t out_cap, size_t* out_len,
+                           size_t* work_size) {
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+    cfg.subsampling = JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+
+    // 每个块是一条 MCU 行的 YUYV 数据
+    int block_size = 0;
+    ret = jpeg_enc_get_block_size(h, &block_size);
+    int stride = (int)width * 2;
+    if (ret != JPEG_ERR_OK || block_size <= 0 || block_size % stride != 0) {
+        ESP_LOGE(TAG, "unexpected block size: %d", block_size);
+        jpeg_enc_close(h);
+        return false;
+    }
+    int rows = block_size / stride;
+
+    // RGB565 缓冲区也作为 LVGL 绘制缓冲区使用，按 64 字节对齐
+    uint8_t* rgb = (uint8_t*)jpeg_calloc_align(block_size, 64);
+    uint8_t* yuyv = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+    esp_imgfx_color_convert_cfg_t convert_cfg = {
+        .in_res = {.width = static_cast<int16_t>(width),
+                    .height = static_cast<int16_t>(rows)},
+        .in_pixel_fmt = big_endian ? ESP_IMGFX_PIXEL_FMT_RGB565_BE : ESP_IMGFX_PIXEL_FMT_RGB565_LE,
+        .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+        .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+    };
+    bool ok = rgb != nullptr && yuyv != nullptr;
+    if (!ok) {
+        ESP_LOGE(TAG, "alloc strip buffers failed");
+    } else if (esp_imgfx_color_convert_open(&convert_cfg, &convert_handle) != ESP_IMGFX_ERR_OK || convert_handle == nullptr) {
+        ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+        ok = false;
+    }
+    if (work_size)
+        *work_size = (size_t)block_size * 2;
+
+    int out_size = 0;
+    for (int y = 0; ok && y < height; y += rows) {
+        int n = (height - y < rows) ? height - y : rows;
+        if (!fill(arg, y, n, rgb)) {
+            ok = false;
+            break;
+        }
+        // 最后一条不足一个块时重复最后一行
+        for (int i = n; i < rows; i++) {
+            memcpy(rgb + i * stride, rgb + (n - 1) * stride, stride);
+        }
+
+        esp_imgfx_data_t convert_input_data = {
+            .data = rgb,
+            .data_len = static_cast<uint32_t>(block_size),
+        };
+        esp_imgfx_data_t convert_output_data = {
+            .data = yuyv,
+            .data_len = static_cast<uint32_t>(block_size),
+        };
+        if (esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data) != ESP_IMGFX_ERR_OK) {
+            ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+            ok = false;
+            break;
+        }
+
+        ret = jpeg_enc_process_with_block(h, yuyv, block_size, out, (int)out_cap, &out_size);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+        }
+    }
+
+    if (convert_handle)
+        esp_imgfx_color_convert_close(convert_handle);
+    jpeg_enc_close(h);
+    if (rgb)
+        jpeg_free_align(rgb);
+    if (yuyv)
+        jpeg_free_align(yuyv);
+
+    if (!ok || out_size <= 0)
+        return false;
+    *out_len = (size_t)out_size;
+    return true;
+}
@@ -63,6 +63,36 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
 bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, 
                       v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+// 分条编码的填充回调函数类型
+// arg: 用户自定义参数, y: 起始行, rows: 行数, rgb565: 待填充的缓冲区（每行 width * 2 字节）
+// 返回: 填充成功返回 true
+typedef bool (*jpg_fill_cb)(void *arg, int y, int rows, uint8_t *rgb565);
+
+/**
+ * @brief 分条将 RGB565 图像编码为 JPEG
+ *
+ * 通过回调函数逐条获取图像数据，只分配一条 MCU 行的输入缓冲区，
+ * 适合整帧缓冲区过大的场景（如屏幕截图）：
+ * - 输入为原生字节序的 RGB565，big_endian 为 true 时按大端读取，字节交换在颜色转换中完成
+ * - JPEG 数据直接写入调用者提供的输出缓冲区，缓冲区不足时返回失败
+ *
+ * @param width       图像宽度
+ * @param height      图像高度
+ * @param big_endian  RGB565 是否为大端字节序
+ * @param quality     JPEG质量 (1-100)
+ * @param fill        填充回调函数，按从上到下的顺序调用
+ * @param arg         传递给回调函数的用户参数
+ * @param out         输出缓冲区
+ * @param out_cap     输出缓冲区大小
+ * @param out_len     输出JPEG数据长度
+ * @param work_size   编码期间分配的输入缓冲区大小（可为 NULL）
+ *
+ * @return true 成功, false 失败
+ */
+bool rgb565_strips_to_jpeg(uint16_t width, uint16_t height, bool big_endian, uint8_t quality,
+                           jpg_fill_cb fill, void *arg, uint8_t *out, size_t out_cap, size_t *out_len,
+                           size_t *work_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <esp_heap_caps.h>
 #include <font_awesome.h>
 
 #include "lvgl_display.h"
@@ -13,6 +14,10 @@
 #include "assets/lang_config.h"
 #include "jpg/image_to_jpeg.h"
 
+#if CONFIG_LV_USE_SNAPSHOT
+#include <lvgl_private.h>
+#endif
+
 #define TAG "Display"
 
 LvglDisplay::LvglDisplay() {
@@ -103,31 +108,19 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ != nullptr) {
-            // Update icon if mute state changes
-            if (codec->output_volume() == 0 && !muted_) {
-                muted_ = true;
-                lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-            } else if (codec->output_volume() > 0 && muted_) {
-                muted_ = false;
-                lv_label_set_text(mute_label_, "");
-            }
-        }
-    }
-
     // Skip auto clock updates to avoid showing time on the top area
 
     esp_pm_lock_acquire(pm_lock_);
+    bool muted = codec->output_volume() == 0;
+
     // Update battery icon
     int battery_level;
     bool charging, discharging;
-    const char* icon = nullptr;
+    const char* battery_icon = nullptr;
+    bool low_battery = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
         if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+            battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -137,34 +130,16 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Show if low battery popup is hidden
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // Hide if low battery popup is shown
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
+            battery_icon = levels[battery_level / 20];
         }
+        low_battery = strcmp(battery_icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
     }
 
-    // Update network icon every 10 seconds
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
+    // The network icon is read on network events and every 10 seconds
+    const char* network_icon = nullptr;
+    if (update_all) {
         // Don't read 4G network status during firmware upgrade to avoid occupying UART resources
-        auto device_state = Application::GetInstance().GetDeviceState();
+        auto device_state = app.GetDeviceState();
         static const std::vector<DeviceState> allowed_states = {
             kDeviceStateIdle,
             kDeviceStateStarting,
@@ -173,16 +148,43 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+            network_icon = board.GetNetworkStateIcon();
         }
     }
 
+    // Only lock the display when an icon changes, so an unchanged status bar never wakes LVGL
+    bool mute_changed = mute_label_ != nullptr && muted != muted_;
+    bool battery_changed = battery_label_ != nullptr && battery_icon != nullptr && battery_icon != battery_icon_;
+    bool low_battery_changed = low_battery_popup_ != nullptr && battery_icon != nullptr && low_battery != low_battery_;
+    bool network_changed = network_label_ != nullptr && network_icon != nullptr && network_icon != network_icon_;
+    if (mute_changed || battery_changed || low_battery_changed || network_changed) {
+        DisplayLockGuard lock(this);
+        if (mute_changed) {
+            muted_ = muted;
+            lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+        }
+        if (battery_changed) {
+            battery_icon_ = battery_icon;
+            lv_label_set_text(battery_label_, battery_icon_);
+        }
+        if (low_battery_changed) {
+            low_battery_ = low_battery;
+            if (low_battery_) {
+                lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            } else {
+                lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+            }
+        }
+        if (network_changed) {
+            network_icon_ = network_icon;
+            lv_label_set_text(network_label_, network_icon_);
+        }
+    }
     esp_pm_lock_release(pm_lock_);
+
+    if (low_battery_changed && low_battery) {
+        app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+    }
 }
 
 void LvglDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -198,42 +200,138 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
     }
 }
 
-bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
-
+// Renders rows of the active screen into a strip buffer, the way lv_snapshot_take
+// renders the whole screen. The caller holds the display lock.
+static bool RenderSnapshotStrip(void* arg, int y, int rows, uint8_t* rgb565) {
     lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
-    if (draw_buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
+    lv_area_t screen_area;
+    lv_obj_get_coords(screen, &screen_area);
+    int32_t width = lv_area_get_width(&screen_area);
+    lv_draw_buf_t draw_buf;
+    if (lv_draw_buf_init(&draw_buf, width, rows, LV_COLOR_FORMAT_RGB565, width * 2, rgb565, width * 2 * rows) != LV_RESULT_OK) {
         return false;
     }
+    lv_draw_buf_clear(&draw_buf, NULL);
+
+    lv_area_t strip_area = screen_area;
+    strip_area.y1 = screen_area.y1 + y;
+    strip_area.y2 = strip_area.y1 + rows - 1;
+
+    lv_layer_t layer;
+    lv_memzero(&layer, sizeof(layer));
+    layer.draw_buf = &draw_buf;
+    layer.buf_area = strip_area;
+    layer.color_format = LV_COLOR_FORMAT_RGB565;
+    layer._clip_area = strip_area;
+    layer.phy_clip_area = strip_area;
+#if LV_DRAW_TRANSFORM_USE_MATRIX
+    lv_matrix_identity(&layer.matrix);
+#endif
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
+    lv_display_t* disp_old = lv_refr_get_disp_refreshing();
+    lv_display_t* disp = lv_obj_get_display(screen);
+    lv_layer_t* layer_old = disp->layer_head;
+    disp->layer_head = &layer;
+    lv_refr_set_disp_refreshing(disp);
+    lv_obj_redraw(&layer, screen);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        lv_draw_dispatch();
     }
+    disp->layer_head = layer_old;
+    lv_refr_set_disp_refreshing(disp_old);
+    return true;
+}
+#endif
 
-    // Clear output string and use callback version to avoid pre-allocating large memory blocks
-    jpeg_data.clear();
+bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+#if CONFIG_LV_USE_SNAPSHOT
+    int width, height;
+    {
+        DisplayLockGuard lock(this);
+        width = lv_obj_get_width(lv_screen_active());
+        height = lv_obj_get_height(lv_screen_active());
+    }
+    auto start_time = esp_timer_get_time();
 
-    // Use callback-based JPEG encoder to further save memory
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-        [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
+#if CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+    // The hardware encoder needs the whole frame, it is used when PSRAM has room for one.
+    // The display is only locked while the frame renders.
+    size_t frame_size = (size_t)width * height * 2;
+    auto frame = (uint8_t*)heap_caps_malloc(frame_size, MALLOC_CAP_SPIRAM);
+    if (frame != nullptr) {
+        bool ret;
+        int64_t lock_us;
+        {
+            DisplayLockGuard lock(this);
+            ret = RenderSnapshotStrip(nullptr, 0, height, frame);
+            lock_us = esp_timer_get_time() - start_time;
         }
-        return len;
-    }, &jpeg_data);
+        if (ret) {
+            // swap bytes
+            uint16_t* data = (uint16_t*)frame;
+            size_t pixel_count = frame_size / 2;
+            for (size_t i = 0; i < pixel_count; i++) {
+                data[i] = __builtin_bswap16(data[i]);
+            }
+
+            jpeg_data.clear();
+            ret = image_to_jpeg_cb(frame, frame_size, width, height, V4L2_PIX_FMT_RGB565, quality,
+                [](void *arg, size_t index, const void *data, size_t len) -> size_t {
+                std::string* output = static_cast<std::string*>(arg);
+                if (data && len > 0) {
+                    output->append(static_cast<const char*>(data), len);
+                }
+                return len;
+            }, &jpeg_data);
+        }
+        heap_caps_free(frame);
+        if (!ret) {
+            ESP_LOGE(TAG, "Failed to convert image to JPEG");
+            return false;
+        }
+        ESP_LOGI(TAG, "Snapshot %dx%d: %u bytes JPEG in %lld ms, frame buffer %u bytes, display locked %lld ms",
+            width, height, jpeg_data.size(), (esp_timer_get_time() - start_time) / 1000, frame_size, lock_us / 1000);
+        return true;
+    }
+#endif
+
+    // The screen is rendered a few rows at a time and encoded straight into jpeg_data,
+    // so no full frame is allocated. The byte swap is done by the colour conversion.
+    // The display stays locked until the last strip so the snapshot is of one frame.
+    // The capacity is far above the size of a UI screen at this quality, it grows once
+    // if the encoder runs out of room.
+    size_t capacity = (size_t)width * height / (quality > 90 ? 1 : 2) + 16 * 1024;
+    size_t jpeg_size = 0;
+    size_t work_size = 0;
+    bool ret = false;
+    int64_t lock_us;
+    {
+        DisplayLockGuard lock(this);
+        auto lock_time = esp_timer_get_time();
+        for (int attempt = 0; attempt < 2 && !ret; attempt++) {
+            if (attempt > 0) {
+                capacity *= 2;
+            }
+            jpeg_data.resize(capacity);
+            ret = rgb565_strips_to_jpeg(width, height, true, quality, RenderSnapshotStrip, nullptr,
+                (uint8_t*)jpeg_data.data(), jpeg_data.size(), &jpeg_size, &work_size);
+        }
+        lock_us = esp_timer_get_time() - lock_time;
+    }
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
+        jpeg_data.clear();
+        return false;
     }
+    jpeg_data.resize(jpeg_size);
+    jpeg_data.shrink_to_fit();
 
-    lv_draw_buf_destroy(draw_buffer);
-    return ret;
+    ESP_LOGI(TAG, "Snapshot %dx%d: %u bytes JPEG in %lld ms, peak buffers %u bytes, display locked %lld ms",
+        width, height, jpeg_size, (esp_timer_get_time() - start_time) / 1000, capacity + work_size,
+        lock_us / 1000);
+    return true;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
     return false;
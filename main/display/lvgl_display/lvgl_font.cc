@@ -1,13 +1,139 @@
 #include "lvgl_font.h"
 #include <cbin_font.h>
 
+#include <cstring>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "LvglFont"
+
+#define GLYPH_CACHE_SIZE (CONFIG_LVGL_GLYPH_CACHE_SIZE_KB * 1024)
+
 
 LvglCBinFont::LvglCBinFont(void* data) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    if (font_ != nullptr) {
+        LvglGlyphCache::GetInstance().Attach(font_);
+    }
 }
 
 LvglCBinFont::~LvglCBinFont() {
     if (font_ != nullptr) {
+        LvglGlyphCache::GetInstance().Detach(font_);
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+void LvglGlyphCache::Attach(lv_font_t* font) {
+    if (GLYPH_CACHE_SIZE == 0 || font->get_glyph_bitmap == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    fonts_.emplace_back(font, font->get_glyph_bitmap);
+    font->get_glyph_bitmap = GetGlyphBitmap;
+}
+
+void LvglGlyphCache::Detach(lv_font_t* font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = fonts_.begin(); it != fonts_.end(); ++it) {
+        if (it->first == font) {
+            font->get_glyph_bitmap = it->second;
+            fonts_.erase(it);
+            break;
+        }
+    }
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        auto next = std::next(it);
+        if (it->key.font == font) {
+            Erase(it);
+        }
+        it = next;
+    }
+}
+
+LvglGlyphCache::GlyphBitmapCallback LvglGlyphCache::FindCallback(const lv_font_t* font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& attached : fonts_) {
+        if (attached.first == font) {
+            return attached.second;
+        }
+    }
+    return nullptr;
+}
+
+const void* LvglGlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto& cache = GetInstance();
+    auto get_glyph_bitmap = cache.FindCallback(g_dsc->resolved_font);
+    if (get_glyph_bitmap == nullptr) {
+        return nullptr;
+    }
+    // Raw bitmaps point into the font data and need no decoding
+    if (draw_buf == nullptr || g_dsc->req_raw_bitmap) {
+        return get_glyph_bitmap(g_dsc, draw_buf);
+    }
+
+    Key key = {g_dsc->resolved_font, g_dsc->gid.index};
+    if (cache.CopyCached(key, draw_buf)) {
+        return draw_buf;
+    }
+
+    auto bitmap = get_glyph_bitmap(g_dsc, draw_buf);
+    if (bitmap == draw_buf) {
+        cache.Insert(key, draw_buf, draw_buf->header.stride * g_dsc->box_h);
+    }
+    return bitmap;
+}
+
+bool LvglGlyphCache::CopyCached(const Key& key, lv_draw_buf_t* draw_buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        auto it = found->second;
+        // The draw buffer is laid out for the glyph, so the stride only differs if LVGL changed it
+        if (it->stride == draw_buf->header.stride && it->size <= draw_buf->data_size) {
+            memcpy(draw_buf->data, it->data, it->size);
+            entries_.splice(entries_.begin(), entries_, it);
+            hits_++;
+            return true;
+        }
+        Erase(it);
+    }
+    misses_++;
+    if (misses_ % 1024 == 0) {
+        ESP_LOGI(TAG, "Glyph cache: %lu hits, %lu misses, %u glyphs, %u of %d bytes", hits_, misses_,
+            entries_.size(), used_bytes_, GLYPH_CACHE_SIZE);
+    }
+    return false;
+}
+
+void LvglGlyphCache::Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint32_t size) {
+    // Very large glyphs would push out many small ones
+    if (size == 0 || size > GLYPH_CACHE_SIZE / 16) {
+        return;
+    }
+    auto data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        return;
+    }
+    memcpy(data, draw_buf->data, size);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another draw unit may have decoded the same glyph meanwhile
+    if (index_.find(key) != index_.end()) {
+        heap_caps_free(data);
+        return;
+    }
+    while (!entries_.empty() && used_bytes_ + size > GLYPH_CACHE_SIZE) {
+        Erase(std::prev(entries_.end()));
+    }
+    entries_.push_front(Entry{key, draw_buf->header.stride, size, data});
+    index_[key] = entries_.begin();
+    used_bytes_ += size;
+}
+
+void LvglGlyphCache::Erase(std::list<Entry>::iterator it) {
+    heap_caps_free(it->data);
+    used_bytes_ -= it->size;
+    index_.erase(it->key);
+    entries_.erase(it);
+}
@@ -2,6 +2,12 @@
 
 #include <lvgl.h>
 
+#include <list>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
 
 class LvglFont {
 public:
@@ -29,3 +35,61 @@ public:
 private:
     lv_font_t* font_;
 };
+
+
+/**
+ * LRU cache of the glyph bitmaps LVGL decodes from the flash-mapped cbin fonts,
+ * kept in PSRAM as drawn (A8), so redrawing text copies them instead of decoding
+ * them again. Entries are keyed by font, one per size, and glyph index, which
+ * stands for the codepoint; the total size is limited to LVGL_GLYPH_CACHE_SIZE_KB.
+ */
+class LvglGlyphCache {
+public:
+    static LvglGlyphCache& GetInstance() {
+        static LvglGlyphCache instance;
+        return instance;
+    }
+
+    // Routes the glyph bitmaps of font through the cache
+    void Attach(lv_font_t* font);
+    // Drops the entries of font before it is deleted
+    void Detach(lv_font_t* font);
+
+    inline uint32_t hits() const { return hits_; }
+    inline uint32_t misses() const { return misses_; }
+    inline size_t used_bytes() const { return used_bytes_; }
+
+private:
+    using GlyphBitmapCallback = const void* (*)(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+
+    struct Key {
+        const lv_font_t* font;
+        uint32_t glyph;
+        bool operator==(const Key& other) const { return font == other.font && glyph == other.glyph; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return (size_t)key.font ^ (key.glyph * 2654435761u); }
+    };
+    struct Entry {
+        Key key;
+        uint32_t stride;
+        uint32_t size;
+        uint8_t* data;
+    };
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    std::vector<std::pair<const lv_font_t*, GlyphBitmapCallback>> fonts_;
+    size_t used_bytes_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+
+    LvglGlyphCache() = default;
+
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    GlyphBitmapCallback FindCallback(const lv_font_t* font);
+    bool CopyCached(const Key& key, lv_draw_buf_t* draw_buf);
+    void Insert(const Key& key, const lv_draw_buf_t* draw_buf, uint32_t size);
+    void Erase(std::list<Entry>::iterator it);
+};
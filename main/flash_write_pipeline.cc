@@ -0,0 +1,124 @@
+#include "flash_write_pipeline.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#define TAG "FlashWritePipeline"
+
+FlashWritePipeline::FlashWritePipeline(size_t buffer_size, int buffer_count,
+    std::function<bool(const char* data, size_t length)> write, std::function<bool()> idle)
+    : buffer_size_(buffer_size), buffer_count_(buffer_count), write_(write), idle_(idle) {
+}
+
+FlashWritePipeline::~FlashWritePipeline() {
+    if (running_) {
+        Finish();
+    }
+    if (buffers_ != nullptr) {
+        for (int i = 0; i < buffer_count_; i++) {
+            heap_caps_free(buffers_[i]);
+        }
+        delete[] buffers_;
+    }
+    if (free_queue_ != nullptr) {
+        vQueueDelete(free_queue_);
+    }
+    if (full_queue_ != nullptr) {
+        vQueueDelete(full_queue_);
+    }
+    if (done_ != nullptr) {
+        vSemaphoreDelete(done_);
+    }
+}
+
+bool FlashWritePipeline::Start(const char* task_name, uint32_t stack_size) {
+    free_queue_ = xQueueCreate(buffer_count_, sizeof(char*));
+    full_queue_ = xQueueCreate(buffer_count_ + 1, sizeof(Chunk));
+    done_ = xSemaphoreCreateBinary();
+    if (free_queue_ == nullptr || full_queue_ == nullptr || done_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create queues");
+        return false;
+    }
+
+    // Flash writes from internal RAM avoid a bounce copy, PSRAM is the fallback
+    buffers_ = new char*[buffer_count_]();
+    for (int i = 0; i < buffer_count_; i++) {
+        buffers_[i] = (char*)heap_caps_malloc(buffer_size_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (buffers_[i] == nullptr) {
+            buffers_[i] = (char*)heap_caps_malloc(buffer_size_, MALLOC_CAP_SPIRAM);
+        }
+        if (buffers_[i] == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes buffer", buffer_size_);
+            return false;
+        }
+        xQueueSend(free_queue_, &buffers_[i], 0);
+    }
+
+    auto ret = xTaskCreate([](void* arg) {
+        static_cast<FlashWritePipeline*>(arg)->WriterTask();
+        vTaskDelete(NULL);
+    }, task_name, stack_size, this, uxTaskPriorityGet(NULL), nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        return false;
+    }
+    running_ = true;
+    return true;
+}
+
+char* FlashWritePipeline::AcquireBuffer() {
+    char* buffer = nullptr;
+    auto start_time = esp_timer_get_time();
+    xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+    wait_us_ += esp_timer_get_time() - start_time;
+    return buffer;
+}
+
+void FlashWritePipeline::Submit(char* buffer, size_t length) {
+    Chunk chunk = {buffer, length};
+    xQueueSend(full_queue_, &chunk, portMAX_DELAY);
+}
+
+bool FlashWritePipeline::Finish() {
+    if (!running_) {
+        return false;
+    }
+    // An empty chunk tells the writer task to stop
+    Chunk chunk = {nullptr, 0};
+    xQueueSend(full_queue_, &chunk, portMAX_DELAY);
+    xSemaphoreTake(done_, portMAX_DELAY);
+    running_ = false;
+    return !failed_;
+}
+
+void FlashWritePipeline::WriterTask() {
+    while (true) {
+        // Work ahead while the network has not delivered the next buffer
+        while (idle_ && !failed_ && uxQueueMessagesWaiting(full_queue_) == 0) {
+            auto start_time = esp_timer_get_time();
+            bool more = idle_();
+            flash_busy_us_ += esp_timer_get_time() - start_time;
+            if (!more) {
+                break;
+            }
+        }
+
+        Chunk chunk;
+        xQueueReceive(full_queue_, &chunk, portMAX_DELAY);
+        if (chunk.data == nullptr) {
+            break;
+        }
+        if (!failed_ && chunk.length > 0) {
+            auto start_time = esp_timer_get_time();
+            if (write_(chunk.data, chunk.length)) {
+                written_bytes_ += chunk.length;
+            } else {
+                failed_ = true;
+            }
+            flash_busy_us_ += esp_timer_get_time() - start_time;
+        }
+        xQueueSend(free_queue_, &chunk.data, portMAX_DELAY);
+    }
+    xSemaphoreGive(done_);
+}
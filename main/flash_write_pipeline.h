@@ -0,0 +1,63 @@
+#ifndef FLASH_WRITE_PIPELINE_H
+#define FLASH_WRITE_PIPELINE_H
+
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+/**
+ * Writes downloaded data to flash in its own task, so network reads overlap with
+ * flash erase and write. The downloading task fills buffers from AcquireBuffer()
+ * and hands them back in order with Submit(). The writer task calls write for each
+ * buffer, and idle while no buffer is waiting (e.g. to erase sectors ahead of the
+ * write cursor); idle returns false when it has nothing left to do.
+ */
+class FlashWritePipeline {
+public:
+    FlashWritePipeline(size_t buffer_size, int buffer_count, std::function<bool(const char* data, size_t length)> write,
+        std::function<bool()> idle = nullptr);
+    ~FlashWritePipeline();
+
+    bool Start(const char* task_name, uint32_t stack_size = 4096);
+    // Blocks until a buffer is free
+    char* AcquireBuffer();
+    void Submit(char* buffer, size_t length);
+    // Waits until every submitted buffer is written, returns false if a write failed
+    bool Finish();
+
+    inline bool failed() const { return failed_; }
+    inline size_t buffer_size() const { return buffer_size_; }
+    inline size_t written_bytes() const { return written_bytes_; }
+    inline int64_t flash_busy_us() const { return flash_busy_us_; }
+    inline int64_t wait_us() const { return wait_us_; }
+
+private:
+    struct Chunk {
+        char* data;
+        size_t length;
+    };
+
+    size_t buffer_size_;
+    int buffer_count_;
+    std::function<bool(const char* data, size_t length)> write_;
+    std::function<bool()> idle_;
+    char** buffers_ = nullptr;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    SemaphoreHandle_t done_ = nullptr;
+    bool running_ = false;
+    std::atomic<bool> failed_ = false;
+    std::atomic<size_t> written_bytes_ = 0;
+    std::atomic<int64_t> flash_busy_us_ = 0;
+    int64_t wait_us_ = 0;
+
+    void WriterTask();
+};
+
+#endif // FLASH_WRITE_PIPELINE_H
@@ -0,0 +1,11 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Decodes an LZ4 block (no frame header) into exactly dst_size bytes,
+// rejecting anything that would read or write out of bounds
+bool Lz4DecompressBlock(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+
+#endif // LZ4_BLOCK_H
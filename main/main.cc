@@ -9,12 +9,14 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "boot_timeline.h"
 
 #define TAG "main"
 
 extern "C" void app_main(void)
 {
     // Initialize NVS flash for WiFi configuration
+    BootTimeline::GetInstance().Begin("nvs_init");
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGW(TAG, "Erasing NVS flash to fix corruption");
@@ -22,6 +24,7 @@ extern "C" void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    BootTimeline::GetInstance().End("nvs_init");
 
     // Initialize and run the application
     auto& app = Application::GetInstance();
@@ -11,6 +11,7 @@
 #include <esp_pthread.h>
 #include <vector>
 #include <climits>
+#include <mutex>
 
 #include "application.h"
 #include "display.h"
@@ -21,13 +22,51 @@
 #include "lvgl_display.h"
 #include "printer/thermal_printer.h"
 #include "display/lvgl_display/jpg/jpeg_to_image.h"
+#if CONFIG_USE_RUNTIME_PROFILER
+#include "runtime_profiler.h"
+#endif
 
 #include <esp_heap_caps.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
 #define TAG "MCP"
 
+/**
+ * Collects the replies of a JSON-RPC batch request.
+ * Every request of the batch holds a reference; when the last one finishes
+ * (including tool calls scheduled on the main task) the replies are sent as one array.
+ */
+class McpBatch {
+public:
+    ~McpBatch() {
+        // A batch made only of notifications gets no reply
+        if (replies_.empty()) {
+            return;
+        }
+        Application::GetInstance().SendMcpMessage([replies = std::move(replies_)](JsonWriter& writer) {
+            writer.Raw("[");
+            for (size_t i = 0; i < replies.size(); i++) {
+                if (i > 0) {
+                    writer.Raw(",");
+                }
+                replies[i](writer);
+            }
+            writer.Raw("]");
+        });
+    }
+
+    void Add(std::function<void(JsonWriter& writer)>&& write_reply) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replies_.push_back(std::move(write_reply));
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::function<void(JsonWriter& writer)>> replies_;
+};
+
 static bool ConvertLvglToRgb565(const lv_img_dsc_t* img_dsc, std::vector<uint16_t>& out, size_t& stride_pixels) {
     out.clear();
     stride_pixels = 0;
@@ -112,7 +151,7 @@ void McpServer::AddCommonTools() {
     // Do not add custom tools here.
     // Custom tools must be added in the board's InitializeTools function.
 
-    AddTool("self.get_device_status",
+    auto device_status = new McpTool("self.get_device_status",
         "Provides the real-time information of the device, including the current status of the audio speaker, screen, battery, network, etc.\n"
         "Use this tool for: \n"
         "1. Answering questions about current condition (e.g. what is the current volume of the audio speaker?)\n"
@@ -121,6 +160,9 @@ void McpServer::AddCommonTools() {
         [&board](const PropertyList& properties) -> ReturnValue {
             return board.GetDeviceStatusJson();
         });
+    // Battery, temperature and signal strength drift slowly, the TTL bounds how stale they get
+    device_status->set_cache_policy(10000, kMcpCacheKeyAudio | kMcpCacheKeyScreen | kMcpCacheKeyNetwork);
+    AddTool(device_status);
 
     AddTool("self.audio_speaker.set_volume", 
         "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
@@ -161,6 +203,7 @@ void McpServer::AddCommonTools() {
                 auto theme = theme_manager.GetTheme(theme_name);
                 if (theme != nullptr) {
                     display->SetTheme(theme);
+                    McpServer::GetInstance().InvalidateCache(kMcpCacheKeyScreen);
                     return true;
                 }
                 return false;
@@ -178,13 +221,15 @@ void McpServer::AddCommonTools() {
             PropertyList({
                 Property("question", kPropertyTypeString)
             }),
-            [camera](const PropertyList& properties) -> ReturnValue {
+            [this, camera](const PropertyList& properties) -> ReturnValue {
                 // Lower the priority to do the camera capture
                 TaskPriorityReset priority_reset(1);
 
+                NotifyProgress(0, 2, "Capturing");
                 if (!camera->Capture()) {
                     throw std::runtime_error("Failed to capture photo");
                 }
+                NotifyProgress(1, 2, "Explaining");
                 auto question = properties["question"].value<std::string>();
                 return camera->Explain(question);
             });
@@ -205,6 +250,17 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+#if CONFIG_USE_RUNTIME_PROFILER
+    AddUserOnlyTool("self.get_runtime_profile",
+        "Get the recent time series of per-task CPU usage, stack high-water marks, heap and mmap usage",
+        PropertyList({
+            Property("samples", kPropertyTypeInteger, 10, 1, RuntimeProfiler::kHistorySize)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return RuntimeProfiler::GetInstance().GetTimeSeriesJson(properties["samples"].value<int>());
+        });
+#endif
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [](const PropertyList& properties) -> ReturnValue {
@@ -238,11 +294,29 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+#if CONFIG_OTA_UPGRADE_BENCHMARK
+    AddUserOnlyTool("self.benchmark_upgrade",
+        "Download a firmware image twice without installing it, comparing the previous download loop with the pipelined one. "
+        "The result is written to the device log.",
+        PropertyList({
+            Property("url", kPropertyTypeString)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto url = new std::string(properties["url"].value<std::string>());
+            xTaskCreate([](void* arg) {
+                std::unique_ptr<std::string> url(static_cast<std::string*>(arg));
+                Ota::RunUpgradeBenchmark(*url);
+                vTaskDelete(nullptr);
+            }, "ota_benchmark", 8192, url, 3, nullptr);
+            return true;
+        });
+#endif
+
     // Display control
 #ifdef HAVE_LVGL
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
     if (display) {
-        AddUserOnlyTool("self.screen.get_info", "Information about the screen, including width, height, etc.",
+        auto screen_info = new McpTool("self.screen.get_info", "Information about the screen, including width, height, etc.",
             PropertyList(),
             [display](const PropertyList& properties) -> ReturnValue {
                 cJSON *json = cJSON_CreateObject();
@@ -255,6 +329,10 @@ void McpServer::AddUserOnlyTools() {
                 }
                 return json;
             });
+        // The screen geometry never changes
+        screen_info->set_user_only(true);
+        screen_info->set_cache_policy(0, 0);
+        AddTool(screen_info);
 
 #if CONFIG_LV_USE_SNAPSHOT
         AddUserOnlyTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
@@ -262,14 +340,16 @@ void McpServer::AddUserOnlyTools() {
                 Property("url", kPropertyTypeString),
                 Property("quality", kPropertyTypeInteger, 80, 1, 100)
             }),
-            [display](const PropertyList& properties) -> ReturnValue {
+            [this, display](const PropertyList& properties) -> ReturnValue {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
+                NotifyProgress(0, 2, "Snapshotting");
                 std::string jpeg_data;
                 if (!display->SnapshotToJpeg(jpeg_data, quality)) {
                     throw std::runtime_error("Failed to snapshot screen");
                 }
+                NotifyProgress(1, 2, "Uploading");
 
                 ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
                 
@@ -315,7 +395,7 @@ void McpServer::AddUserOnlyTools() {
             PropertyList({
                 Property("url", kPropertyTypeString)
             }),
-            [display](const PropertyList& properties) -> ReturnValue {
+            [this, display](const PropertyList& properties) -> ReturnValue {
                 auto url = properties["url"].value<std::string>();
                 auto http = Board::GetInstance().GetNetwork()->CreateHttp(3);
 
@@ -333,6 +413,8 @@ void McpServer::AddUserOnlyTools() {
                     throw std::runtime_error("Failed to allocate memory for image: " + url);
                 }
                 size_t total_read = 0;
+                int last_percent = 0;
+                NotifyProgress(0, 100, "Downloading");
                 while (total_read < content_length) {
                     int ret = http->Read(data + total_read, content_length - total_read);
                     if (ret < 0) {
@@ -343,6 +425,12 @@ void McpServer::AddUserOnlyTools() {
                         break;
                     }
                     total_read += ret;
+                    // Report every 10% to keep the notification traffic low
+                    int percent = static_cast<int>(total_read * 100 / content_length);
+                    if (percent - last_percent >= 10) {
+                        last_percent = percent;
+                        NotifyProgress(percent, 100, "Downloading");
+                    }
                 }
                 http->Close();
 
@@ -465,6 +553,23 @@ void McpServer::ParseCapabilities(const cJSON* capabilities) {
 }
 
 void McpServer::ParseMessage(const cJSON* json) {
+    if (!cJSON_IsArray(json)) {
+        ParseRequest(json, nullptr);
+        return;
+    }
+
+    // Batch request: all replies are sent back together in a single array
+    if (cJSON_GetArraySize(json) == 0) {
+        ESP_LOGE(TAG, "Empty batch request");
+        return;
+    }
+    auto batch = std::make_shared<McpBatch>();
+    for (const cJSON* request = json->child; request != nullptr; request = request->next) {
+        ParseRequest(request, batch);
+    }
+}
+
+void McpServer::ParseRequest(const cJSON* json, const std::shared_ptr<McpBatch>& batch) {
     // Check JSONRPC version
     auto version = cJSON_GetObjectItem(json, "jsonrpc");
     if (version == nullptr || !cJSON_IsString(version) || strcmp(version->valuestring, "2.0") != 0) {
@@ -509,7 +614,7 @@ void McpServer::ParseMessage(const cJSON* json) {
         std::string message = "{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"tools\":{}},\"serverInfo\":{\"name\":\"" BOARD_NAME "\",\"version\":\"";
         message += app_desc->version;
         message += "\"}}";
-        ReplyResult(id_int, message);
+        ReplyResult(id_int, message, batch);
     } else if (method_str == "tools/list") {
         std::string cursor_str = "";
         bool list_user_only_tools = false;
@@ -523,56 +628,87 @@ void McpServer::ParseMessage(const cJSON* json) {
                 list_user_only_tools = with_user_tools->valueint == 1;
             }
         }
-        GetToolsList(id_int, cursor_str, list_user_only_tools);
+        GetToolsList(id_int, cursor_str, list_user_only_tools, batch);
     } else if (method_str == "tools/call") {
         if (!cJSON_IsObject(params)) {
             ESP_LOGE(TAG, "tools/call: Missing params");
-            ReplyError(id_int, "Missing params");
+            ReplyError(id_int, "Missing params", batch);
             return;
         }
         auto tool_name = cJSON_GetObjectItem(params, "name");
         if (!cJSON_IsString(tool_name)) {
             ESP_LOGE(TAG, "tools/call: Missing name");
-            ReplyError(id_int, "Missing name");
+            ReplyError(id_int, "Missing name", batch);
             return;
         }
         auto tool_arguments = cJSON_GetObjectItem(params, "arguments");
         if (tool_arguments != nullptr && !cJSON_IsObject(tool_arguments)) {
             ESP_LOGE(TAG, "tools/call: Invalid arguments");
-            ReplyError(id_int, "Invalid arguments");
+            ReplyError(id_int, "Invalid arguments", batch);
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments);
+        std::string progress_token;
+        auto meta = cJSON_GetObjectItem(params, "_meta");
+        if (cJSON_IsObject(meta)) {
+            auto token = cJSON_GetObjectItem(meta, "progressToken");
+            if (cJSON_IsString(token) || cJSON_IsNumber(token)) {
+                char* token_json = cJSON_PrintUnformatted(token);
+                if (token_json != nullptr) {
+                    progress_token = token_json;
+                    cJSON_free(token_json);
+                }
+            }
+        }
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, std::move(progress_token), batch);
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
-        ReplyError(id_int, "Method not implemented: " + method_str);
+        ReplyError(id_int, "Method not implemented: " + method_str, batch);
+    }
+}
+
+void McpServer::SendReply(const std::shared_ptr<McpBatch>& batch, std::function<void(JsonWriter& writer)>&& write_reply) {
+    if (batch) {
+        batch->Add(std::move(write_reply));
+    } else {
+        Application::GetInstance().SendMcpMessage(std::move(write_reply));
     }
 }
 
-void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
-    payload += result;
-    payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+void McpServer::ReplyResult(int id, const std::string& result, const std::shared_ptr<McpBatch>& batch) {
+    ReplyResult(id, [result](JsonWriter& writer) {
+        writer.Raw(result);
+    }, batch);
+}
+
+void McpServer::ReplyResult(int id, std::function<void(JsonWriter& writer)>&& write_result, const std::shared_ptr<McpBatch>& batch) {
+    SendReply(batch, [id, write_result = std::move(write_result)](JsonWriter& writer) {
+        writer.Raw("{\"jsonrpc\":\"2.0\",\"id\":");
+        writer.Int(id);
+        writer.Raw(",\"result\":");
+        write_result(writer);
+        writer.Raw("}");
+    });
 }
 
-void McpServer::ReplyError(int id, const std::string& message) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
-    Application::GetInstance().SendMcpMessage(payload);
+void McpServer::ReplyError(int id, const std::string& message, const std::shared_ptr<McpBatch>& batch) {
+    SendReply(batch, [id, message](JsonWriter& writer) {
+        writer.Raw("{\"jsonrpc\":\"2.0\",\"id\":");
+        writer.Int(id);
+        writer.Raw(",\"error\":{\"message\":");
+        writer.String(message);
+        writer.Raw("}}");
+    });
 }
 
-void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
+void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools, const std::shared_ptr<McpBatch>& batch) {
     const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
+    const size_t header_size = 10; // {"tools":[
+    size_t payload_size = header_size;
     
     bool found_cursor = cursor.empty();
     auto it = tools_.begin();
     std::string next_cursor = "";
+    std::vector<McpTool*> page;
     
     while (it != tools_.end()) {
         // 如果我们还没有找到起始位置，继续搜索
@@ -591,38 +727,45 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
         }
         
         // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
+        size_t tool_size = (*it)->json().size() + 1;
+        if (payload_size + tool_size + 30 > max_payload_size) {
             // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
             next_cursor = (*it)->name();
             break;
         }
         
-        json += tool_json;
+        payload_size += tool_size;
+        page.push_back(*it);
         ++it;
     }
     
-    if (json.back() == ',') {
-        json.pop_back();
-    }
-    
-    if (json.back() == '[' && !tools_.empty()) {
+    if (page.empty() && !tools_.empty()) {
         // 如果没有添加任何tool，返回错误
         ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
+        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit", batch);
         return;
     }
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
-    }
-    
-    ReplyResult(id, json);
+    // Tool descriptions are cached, so the page is streamed without building the list in memory
+    ReplyResult(id, [page = std::move(page), next_cursor = std::move(next_cursor)](JsonWriter& writer) {
+        writer.Raw("{\"tools\":[");
+        for (size_t i = 0; i < page.size(); i++) {
+            if (i > 0) {
+                writer.Raw(",");
+            }
+            writer.Raw(page[i]->json());
+        }
+        writer.Raw("]");
+        if (!next_cursor.empty()) {
+            writer.Raw(",\"nextCursor\":");
+            writer.String(next_cursor);
+        }
+        writer.Raw("}");
+    }, batch);
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments,
+    std::string&& progress_token, const std::shared_ptr<McpBatch>& batch) {
     auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
                                  [&tool_name](const McpTool* tool) { 
                                      return tool->name() == tool_name; 
@@ -630,48 +773,267 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
     
     if (tool_iter == tools_.end()) {
         ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
-        ReplyError(id, "Unknown tool: " + tool_name);
+        ReplyError(id, "Unknown tool: " + tool_name, batch);
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
-    try {
-        for (auto& argument : arguments) {
-            bool found = false;
-            if (cJSON_IsObject(tool_arguments)) {
-                auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
-                if (argument.type() == kPropertyTypeBoolean && cJSON_IsBool(value)) {
-                    argument.set_value<bool>(value->valueint == 1);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
-                    argument.set_value<int>(value->valueint);
-                    found = true;
-                } else if (argument.type() == kPropertyTypeString && cJSON_IsString(value)) {
-                    argument.set_value<std::string>(value->valuestring);
-                    found = true;
-                }
-            }
-
-            if (!argument.has_default_value() && !found) {
-                ESP_LOGE(TAG, "tools/call: Missing valid argument: %s", argument.name().c_str());
-                ReplyError(id, "Missing valid argument: " + argument.name());
-                return;
-            }
-        }
-    } catch (const std::exception& e) {
-        ESP_LOGE(TAG, "tools/call: %s", e.what());
-        ReplyError(id, e.what());
+    auto tool = *tool_iter;
+    auto arguments = tool->AcquireFrame();
+    int error_slot = -1;
+    auto error = tool->BindArguments(tool_arguments, *arguments, error_slot);
+    if (error != kMcpArgumentOk) {
+        auto message = tool->GetArgumentErrorMessage(error, error_slot);
+        tool->ReleaseFrame(arguments);
+        ESP_LOGE(TAG, "tools/call: %s", message.c_str());
+        ReplyError(id, message, batch);
         return;
     }
 
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    app.Schedule([this, id, tool, arguments, progress_token = std::move(progress_token), batch]() {
+        // Idempotent getters are answered from their serialized result while it is valid.
+        // The generation is read before the call so a change during the call is not missed.
+        uint32_t generation = 0;
+        if (tool->cacheable()) {
+            generation = GetCacheGeneration(tool->cache_keys());
+            auto cached = tool->GetCachedResult(generation, esp_timer_get_time());
+            if (cached) {
+                tool->ReleaseFrame(arguments);
+                ReplyResult(id, [cached](JsonWriter& writer) {
+                    writer.Raw(*cached);
+                }, batch);
+                return;
+            }
+        }
+
+        std::shared_ptr<McpToolResult> result;
+        progress_token_ = progress_token;
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            result = tool->Call(*arguments);
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
-            ReplyError(id, e.what());
+            ReplyError(id, e.what(), batch);
+        }
+        progress_token_.clear();
+        tool->ReleaseFrame(arguments);
+        if (result && tool->cacheable()) {
+            auto serialized = std::make_shared<std::string>();
+            char buffer[128];
+            JsonWriter writer(buffer, sizeof(buffer), [&serialized](const char* data, size_t length, bool last) {
+                serialized->append(data, length);
+                return true;
+            });
+            result->Write(writer);
+            writer.Finish();
+            tool->StoreCachedResult(serialized, generation, esp_timer_get_time());
+            ReplyResult(id, [serialized](JsonWriter& writer) {
+                writer.Raw(*serialized);
+            }, batch);
+        } else if (result) {
+            // The result is serialized while it is being sent
+            ReplyResult(id, [result](JsonWriter& writer) {
+                result->Write(writer);
+            }, batch);
+        }
+    });
+}
+
+void McpServer::InvalidateCache(uint32_t keys) {
+    for (int i = 0; i < kCacheKeyCount; i++) {
+        if (keys & (1u << i)) {
+            cache_generations_[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+uint32_t McpServer::GetCacheGeneration(uint32_t keys) const {
+    // Generations only grow, so the sum changes whenever one of the keys is invalidated
+    uint32_t generation = 0;
+    for (int i = 0; i < kCacheKeyCount; i++) {
+        if (keys & (1u << i)) {
+            generation += cache_generations_[i].load(std::memory_order_relaxed);
+        }
+    }
+    return generation;
+}
+
+std::shared_ptr<const std::string> McpTool::GetCachedResult(uint32_t generation, int64_t now_us) {
+    bool valid = cached_result_ != nullptr && cached_generation_ == generation &&
+        (cache_ttl_ms_ == 0 || now_us - cached_at_us_ < static_cast<int64_t>(cache_ttl_ms_) * 1000);
+    if (!valid) {
+        cached_result_.reset();
+        cache_misses_++;
+        ESP_LOGD(TAG, "tools/call: %s cache miss (hits %lu, misses %lu)", name_.c_str(), cache_hits_, cache_misses_);
+        return nullptr;
+    }
+    cache_hits_++;
+    ESP_LOGD(TAG, "tools/call: %s cache hit (hits %lu, misses %lu)", name_.c_str(), cache_hits_, cache_misses_);
+    return cached_result_;
+}
+
+void McpServer::NotifyProgress(int progress, int total, const std::string& message) {
+    if (progress_token_.empty()) {
+        return;
+    }
+    // Sent immediately because the calling tool is blocking the main task
+    Application::GetInstance().SendMcpMessage([token = progress_token_, progress, total, message](JsonWriter& writer) {
+        writer.Raw("{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":");
+        writer.Raw(token);
+        writer.Raw(",\"progress\":");
+        writer.Int(progress);
+        if (total > 0) {
+            writer.Raw(",\"total\":");
+            writer.Int(total);
         }
+        if (!message.empty()) {
+            writer.Raw(",\"message\":");
+            writer.String(message);
+        }
+        writer.Raw("}}");
     });
 }
+
+McpArgumentError McpTool::BindArguments(const cJSON* arguments, PropertyList& frame, int& error_slot) const {
+    const size_t count = schema_.size();
+    uint32_t bound = 0;
+
+    // Walk the argument object once and bind each member into its slot
+    if (count > 0 && cJSON_IsObject(arguments)) {
+        for (const cJSON* item = arguments->child; item != nullptr; item = item->next) {
+            if (item->string == nullptr) {
+                continue;
+            }
+            size_t index = 0;
+            while (index < count && strcmp(schema_[index].name, item->string) != 0) {
+                index++;
+            }
+            if (index == count || (bound & (1u << index))) {
+                continue;
+            }
+
+            const auto& slot = schema_[index];
+            auto& property = frame[index];
+            if (slot.type == kPropertyTypeBoolean && cJSON_IsBool(item)) {
+                property.set_value<bool>(cJSON_IsTrue(item));
+            } else if (slot.type == kPropertyTypeInteger && cJSON_IsNumber(item)) {
+                if (slot.has_range && (item->valueint < slot.min_value || item->valueint > slot.max_value)) {
+                    error_slot = index;
+                    return kMcpArgumentOutOfRange;
+                }
+                property.set_value<int>(item->valueint);
+            } else if (slot.type == kPropertyTypeString && cJSON_IsString(item)) {
+                property.set_value(item->valuestring);
+            } else {
+                continue;
+            }
+            bound |= 1u << index;
+        }
+    }
+
+    // Required arguments must be present, optional ones fall back to their default
+    for (size_t index = 0; index < count; index++) {
+        if (bound & (1u << index)) {
+            continue;
+        }
+        if (schema_[index].required) {
+            error_slot = index;
+            return kMcpArgumentMissing;
+        }
+        frame[index].assign_value_from(properties_[index]);
+    }
+    return kMcpArgumentOk;
+}
+
+std::string McpTool::GetArgumentErrorMessage(McpArgumentError error, int error_slot) const {
+    if (error_slot < 0 || error_slot >= static_cast<int>(schema_.size())) {
+        return "Invalid arguments";
+    }
+    const auto& slot = schema_[error_slot];
+    switch (error) {
+        case kMcpArgumentMissing:
+            return std::string("Missing valid argument: ") + slot.name;
+        case kMcpArgumentOutOfRange:
+            return std::string("Value of argument ") + slot.name + " is out of range [" +
+                std::to_string(slot.min_value) + ", " + std::to_string(slot.max_value) + "]";
+        default:
+            return "Invalid arguments";
+    }
+}
+
+#if CONFIG_MCP_TOOL_CALL_BENCHMARK
+/*
+ * Compare the legacy argument path (copy the PropertyList, look up each argument
+ * by name, validate through exceptions) against the compiled schema path for
+ * typical set_volume / set_brightness requests, from JSON text to reply payload.
+ * The tool callbacks are no-ops so that no hardware or NVS is touched.
+ */
+void McpServer::RunToolCallBenchmark() {
+    const int kIterations = 1000;
+    auto no_op = [](const PropertyList& properties) -> ReturnValue {
+        return true;
+    };
+    McpTool volume_tool("self.audio_speaker.set_volume", "", PropertyList({
+        Property("volume", kPropertyTypeInteger, 0, 100)
+    }), no_op);
+    McpTool brightness_tool("self.screen.set_brightness", "", PropertyList({
+        Property("brightness", kPropertyTypeInteger, 0, 100)
+    }), no_op);
+
+    struct BenchmarkCase {
+        McpTool* tool;
+        const char* request;
+    };
+    const BenchmarkCase cases[] = {
+        { &volume_tool, "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"tools/call\",\"params\":{\"name\":\"self.audio_speaker.set_volume\",\"arguments\":{\"volume\":60}}}" },
+        { &brightness_tool, "{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"tools/call\",\"params\":{\"name\":\"self.screen.set_brightness\",\"arguments\":{\"brightness\":80}}}" },
+    };
+
+    for (const auto& c : cases) {
+        auto tool = c.tool;
+        for (int pass = 0; pass < 2; pass++) {
+            bool legacy = pass == 0;
+            auto start_time = esp_timer_get_time();
+            for (int i = 0; i < kIterations; i++) {
+                cJSON* json = cJSON_Parse(c.request);
+                auto params = cJSON_GetObjectItem(json, "params");
+                auto tool_arguments = cJSON_GetObjectItem(params, "arguments");
+                std::string payload;
+                char buffer[256];
+                JsonWriter writer(buffer, sizeof(buffer), [&payload](const char* data, size_t length, bool last) {
+                    payload.append(data, length);
+                    return true;
+                });
+                writer.Raw("{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":");
+                if (legacy) {
+                    PropertyList arguments = tool->properties();
+                    try {
+                        for (auto& argument : arguments) {
+                            auto value = cJSON_GetObjectItem(tool_arguments, argument.name().c_str());
+                            if (argument.type() == kPropertyTypeInteger && cJSON_IsNumber(value)) {
+                                argument.set_value<int>(value->valueint);
+                            }
+                        }
+                        tool->Call(arguments)->Write(writer);
+                    } catch (const std::exception& e) {
+                        writer.String(e.what());
+                    }
+                } else {
+                    auto arguments = tool->AcquireFrame();
+                    int error_slot = -1;
+                    if (tool->BindArguments(tool_arguments, *arguments, error_slot) == kMcpArgumentOk) {
+                        tool->Call(*arguments)->Write(writer);
+                    }
+                    tool->ReleaseFrame(arguments);
+                }
+                writer.Raw("}");
+                writer.Finish();
+                cJSON_Delete(json);
+            }
+            auto elapsed = esp_timer_get_time() - start_time;
+            ESP_LOGI(TAG, "Benchmark %s [%s]: %lld us/call", tool->name().c_str(),
+                legacy ? "legacy" : "compiled", elapsed / kIterations);
+        }
+    }
+}
+#endif // CONFIG_MCP_TOOL_CALL_BENCHMARK
@@ -9,13 +9,19 @@
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mbedtls/base64.h>
+#include "sdkconfig.h"
 
 #include <cJSON.h>
 
+#include "json_writer.h"
+
 class ImageContent {
 private:
-    std::string encoded_data_;
+    std::string data_;
     std::string mime_type_;
 
     static std::string Base64Encode(const std::string& data) {
@@ -23,27 +29,46 @@ private:
         mbedtls_base64_encode((unsigned char*)nullptr, 0, &dlen, (const unsigned char*)data.data(), data.size());
         std::string result(dlen, 0);
         mbedtls_base64_encode((unsigned char*)result.data(), result.size(), &olen, (const unsigned char*)data.data(), data.size());
+        result.resize(olen);
         return result;
     }
 
 public:
+    // The raw data is kept as is and only base64 encoded while it is written out
     ImageContent(const std::string& mime_type, const std::string& data) {
         mime_type_ = mime_type;
-        // base64 encode data
-        encoded_data_ = Base64Encode(data);
+        data_ = data;
     }
 
     std::string to_json() const {
         cJSON *json = cJSON_CreateObject();
         cJSON_AddStringToObject(json, "type", "image");
         cJSON_AddStringToObject(json, "mimeType", mime_type_.c_str());
-        cJSON_AddStringToObject(json, "data", encoded_data_.c_str());
+        cJSON_AddStringToObject(json, "data", Base64Encode(data_).c_str());
         char* json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
         cJSON_Delete(json);
         return result;
     }
+
+    // Write to_json() as a JSON string value, encoding the image chunk by chunk
+    void WriteJsonString(JsonWriter& writer) const {
+        std::string mime_type;
+        char buffer[64];
+        JsonWriter mime_writer(buffer, sizeof(buffer), [&mime_type](const char* data, size_t length, bool last) {
+            mime_type.append(data, length);
+            return true;
+        });
+        mime_writer.String(mime_type_);
+        mime_writer.Finish();
+
+        const std::string head = "{\"type\":\"image\",\"mimeType\":" + mime_type + ",\"data\":\"";
+        writer.Raw("\"");
+        writer.StringContent(head.data(), head.size());
+        writer.Base64((const uint8_t*)data_.data(), data_.size());
+        writer.Raw("\\\"}\"");
+    }
 };
 
 // 添加类型别名
@@ -120,6 +145,20 @@ public:
         value_ = value;
     }
 
+    // Assign a string value in place, reusing the capacity of the current string
+    inline void set_value(const char* value) {
+        if (auto str = std::get_if<std::string>(&value_)) {
+            str->assign(value);
+        } else {
+            value_ = std::string(value);
+        }
+    }
+
+    // Copy only the value (not the name or limits) from another property of the same schema
+    inline void assign_value_from(const Property& other) {
+        value_ = other.value_;
+    }
+
     std::string to_json() const {
         cJSON *json = cJSON_CreateObject();
         
@@ -175,8 +214,14 @@ public:
         throw std::runtime_error("Property not found: " + name);
     }
 
+    inline Property& operator[](size_t index) { return properties_[index]; }
+    inline const Property& operator[](size_t index) const { return properties_[index]; }
+    inline size_t size() const { return properties_.size(); }
+
     auto begin() { return properties_.begin(); }
     auto end() { return properties_.end(); }
+    auto begin() const { return properties_.begin(); }
+    auto end() const { return properties_.end(); }
 
     std::vector<std::string> GetRequired() const {
         std::vector<std::string> required;
@@ -205,14 +250,115 @@ public:
     }
 };
 
+// Owns the value returned by a tool callback until it has been written to the reply
+class McpToolResult {
+private:
+    ReturnValue value_;
+
+public:
+    explicit McpToolResult(ReturnValue&& value) : value_(std::move(value)) {}
+    ~McpToolResult() {
+        if (std::holds_alternative<ImageContent*>(value_)) {
+            delete std::get<ImageContent*>(value_);
+        } else if (std::holds_alternative<cJSON*>(value_)) {
+            cJSON_Delete(std::get<cJSON*>(value_));
+        }
+    }
+    McpToolResult(const McpToolResult&) = delete;
+    McpToolResult& operator=(const McpToolResult&) = delete;
+
+    void Write(JsonWriter& writer) const {
+        writer.Raw("{\"content\":[");
+        if (std::holds_alternative<ImageContent*>(value_)) {
+            writer.Raw("{\"type\":\"image\",\"image\":");
+            std::get<ImageContent*>(value_)->WriteJsonString(writer);
+        } else {
+            writer.Raw("{\"type\":\"text\",\"text\":");
+            if (std::holds_alternative<std::string>(value_)) {
+                writer.String(std::get<std::string>(value_));
+            } else if (std::holds_alternative<bool>(value_)) {
+                writer.String(std::get<bool>(value_) ? "true" : "false");
+            } else if (std::holds_alternative<int>(value_)) {
+                writer.String(std::to_string(std::get<int>(value_)));
+            } else if (std::holds_alternative<cJSON*>(value_)) {
+                char* json_str = cJSON_PrintUnformatted(std::get<cJSON*>(value_));
+                writer.String(json_str != nullptr ? json_str : "");
+                cJSON_free(json_str);
+            }
+        }
+        writer.Raw("}],\"isError\":false}");
+    }
+};
+
+// Result of binding the arguments of a tools/call request
+enum McpArgumentError {
+    kMcpArgumentOk = 0,
+    kMcpArgumentMissing,     // Required argument absent or of the wrong type
+    kMcpArgumentOutOfRange,  // Integer argument outside [minimum, maximum]
+};
+
+// One entry of a compiled tool schema, indexed like the tool's PropertyList
+struct McpArgumentSlot {
+    const char* name;  // Points into the tool's own PropertyList
+    PropertyType type;
+    bool required;
+    bool has_range;
+    int min_value;
+    int max_value;
+};
+
+// State that cached tool results depend on. Changing it invalidates every
+// cached result declared with the key (see McpTool::set_cache_policy)
+enum McpCacheKey : uint32_t {
+    kMcpCacheKeyAudio = 1 << 0,    // Output volume
+    kMcpCacheKeyScreen = 1 << 1,   // Brightness, theme
+    kMcpCacheKeyNetwork = 1 << 2,  // Connection, SSID, signal
+};
+
 class McpTool {
 private:
+    static constexpr size_t kMaxArguments = 32;
+
     std::string name_;
     std::string description_;
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
     bool user_only_ = false;
 
+    // Schema compiled once at registration, and a reusable argument frame
+    // so that a tool call does not copy the whole PropertyList
+    std::vector<McpArgumentSlot> schema_;
+    PropertyList frame_;
+    std::string json_;
+    std::atomic<bool> frame_in_use_{false};
+
+    // Serialized result of an idempotent getter, only touched on the main task
+    bool cacheable_ = false;
+    uint32_t cache_ttl_ms_ = 0;
+    uint32_t cache_keys_ = 0;
+    std::shared_ptr<const std::string> cached_result_;
+    int64_t cached_at_us_ = 0;
+    uint32_t cached_generation_ = 0;
+    uint32_t cache_hits_ = 0;
+    uint32_t cache_misses_ = 0;
+
+    void CompileSchema() {
+        if (properties_.size() > kMaxArguments) {
+            throw std::invalid_argument("Too many arguments for tool: " + name_);
+        }
+        schema_.reserve(properties_.size());
+        for (const auto& property : properties_) {
+            schema_.push_back(McpArgumentSlot{
+                .name = property.name().c_str(),
+                .type = property.type(),
+                .required = !property.has_default_value(),
+                .has_range = property.has_range(),
+                .min_value = property.min_value(),
+                .max_value = property.max_value(),
+            });
+        }
+    }
+
 public:
     McpTool(const std::string& name, 
             const std::string& description, 
@@ -221,13 +367,76 @@ public:
         : name_(name), 
         description_(description), 
         properties_(properties), 
-        callback_(callback) {}
+        callback_(callback),
+        frame_(properties) {
+        CompileSchema();
+    }
+
+    McpTool(const McpTool&) = delete;
+    McpTool& operator=(const McpTool&) = delete;
 
     void set_user_only(bool user_only) { user_only_ = user_only; }
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
+    inline const std::vector<McpArgumentSlot>& schema() const { return schema_; }
     inline bool user_only() const { return user_only_; }
+    inline bool cacheable() const { return cacheable_; }
+    inline uint32_t cache_keys() const { return cache_keys_; }
+    inline uint32_t cache_hits() const { return cache_hits_; }
+    inline uint32_t cache_misses() const { return cache_misses_; }
+
+    /**
+     * Declare the tool as an idempotent getter so its serialized result can be
+     * reused. The result expires after ttl_ms (0 means never) or as soon as
+     * any of the McpCacheKey bits in keys is invalidated.
+     * Only tools without arguments can be cached.
+     */
+    void set_cache_policy(uint32_t ttl_ms, uint32_t keys) {
+        if (properties_.size() > 0) {
+            throw std::invalid_argument("Only tools without arguments can be cached: " + name_);
+        }
+        cacheable_ = true;
+        cache_ttl_ms_ = ttl_ms;
+        cache_keys_ = keys;
+    }
+
+    // Return the cached result if it is still valid for the key generation, counting hits and misses
+    std::shared_ptr<const std::string> GetCachedResult(uint32_t generation, int64_t now_us);
+    void StoreCachedResult(std::shared_ptr<const std::string> result, uint32_t generation, int64_t now_us) {
+        cached_result_ = std::move(result);
+        cached_generation_ = generation;
+        cached_at_us_ = now_us;
+    }
+
+    /**
+     * Get an argument frame to bind a call into. The preallocated frame is
+     * returned unless a previous call is still pending, in which case a
+     * temporary copy is made. Must be paired with ReleaseFrame().
+     */
+    PropertyList* AcquireFrame() {
+        bool expected = false;
+        if (frame_in_use_.compare_exchange_strong(expected, true)) {
+            return &frame_;
+        }
+        return new PropertyList(properties_);
+    }
+
+    void ReleaseFrame(PropertyList* frame) {
+        if (frame == &frame_) {
+            frame_in_use_.store(false);
+        } else {
+            delete frame;
+        }
+    }
+
+    /**
+     * Bind the JSON arguments into the frame by schema index. Arguments that
+     * are absent take their default value. Does not throw; on failure the
+     * offending schema index is stored in error_slot.
+     */
+    McpArgumentError BindArguments(const cJSON* arguments, PropertyList& frame, int& error_slot) const;
+    std::string GetArgumentErrorMessage(McpArgumentError error, int error_slot) const;
 
     std::string to_json() const {
         std::vector<std::string> required = properties_.GetRequired();
@@ -269,48 +478,21 @@ public:
         return result;
     }
 
-    std::string Call(const PropertyList& properties) {
-        ReturnValue return_value = callback_(properties);
-        // 返回结果
-        cJSON* result = cJSON_CreateObject();
-        cJSON* content = cJSON_CreateArray();
-
-        if (std::holds_alternative<ImageContent*>(return_value)) {
-            auto image_content = std::get<ImageContent*>(return_value);
-            cJSON* image = cJSON_CreateObject();
-            cJSON_AddStringToObject(image, "type", "image");
-            cJSON_AddStringToObject(image, "image", image_content->to_json().c_str());
-            cJSON_AddItemToArray(content, image);
-            delete image_content;
-        } else {
-            cJSON* text = cJSON_CreateObject();
-            cJSON_AddStringToObject(text, "type", "text");
-            if (std::holds_alternative<std::string>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
-            } else if (std::holds_alternative<bool>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
-            } else if (std::holds_alternative<int>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
-            } else if (std::holds_alternative<cJSON*>(return_value)) {
-                cJSON* json = std::get<cJSON*>(return_value);
-                char* json_str = cJSON_PrintUnformatted(json);
-                cJSON_AddStringToObject(text, "text", json_str);
-                cJSON_free(json_str);
-                cJSON_Delete(json);
-            }
-            cJSON_AddItemToArray(content, text);
+    // Serialized tool description, built on first use
+    const std::string& json() {
+        if (json_.empty()) {
+            json_ = to_json();
         }
-        cJSON_AddItemToObject(result, "content", content);
-        cJSON_AddBoolToObject(result, "isError", false);
+        return json_;
+    }
 
-        auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(result);
-        return result_str;
+    std::shared_ptr<McpToolResult> Call(const PropertyList& properties) {
+        return std::make_shared<McpToolResult>(callback_(properties));
     }
 };
 
+class McpBatch;
+
 class McpServer {
 public:
     static McpServer& GetInstance() {
@@ -325,20 +507,40 @@ public:
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    // Send notifications/progress for the tool call running on the main task.
+    // Ignored unless the caller supplied params._meta.progressToken; total <= 0 means unknown.
+    void NotifyProgress(int progress, int total, const std::string& message = "");
+    // Drop cached tool results depending on any of the McpCacheKey bits. Can be called from any task.
+    void InvalidateCache(uint32_t keys);
+#if CONFIG_MCP_TOOL_CALL_BENCHMARK
+    void RunToolCallBenchmark();
+#endif
 
 private:
+    static constexpr int kCacheKeyCount = 3;
+
     McpServer();
     ~McpServer();
 
     void ParseCapabilities(const cJSON* capabilities);
+    void ParseRequest(const cJSON* json, const std::shared_ptr<McpBatch>& batch);
 
-    void ReplyResult(int id, const std::string& result);
-    void ReplyError(int id, const std::string& message);
+    // Replies go into the batch when the request was part of one, otherwise they are sent directly
+    void SendReply(const std::shared_ptr<McpBatch>& batch, std::function<void(JsonWriter& writer)>&& write_reply);
+    void ReplyResult(int id, const std::string& result, const std::shared_ptr<McpBatch>& batch = nullptr);
+    void ReplyResult(int id, std::function<void(JsonWriter& writer)>&& write_result, const std::shared_ptr<McpBatch>& batch = nullptr);
+    void ReplyError(int id, const std::string& message, const std::shared_ptr<McpBatch>& batch = nullptr);
 
-    void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
+    void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools, const std::shared_ptr<McpBatch>& batch);
+    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments,
+        std::string&& progress_token, const std::shared_ptr<McpBatch>& batch);
+    uint32_t GetCacheGeneration(uint32_t keys) const;
 
     std::vector<McpTool*> tools_;
+    // JSON text of the progressToken of the tool call currently running, empty if none
+    std::string progress_token_;
+    // Bumped on every invalidation of the corresponding McpCacheKey bit
+    std::atomic<uint32_t> cache_generations_[kCacheKeyCount] = {};
 };
 
 #endif // MCP_SERVER_H
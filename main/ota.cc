@@ -2,22 +2,32 @@
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "flash_write_pipeline.h"
+#include "lz4_block.h"
 #include <cJSON.h>
 #include <esp_log.h>
 #include <esp_partition.h>
 #include <esp_ota_ops.h>
+#include <esp_idf_version.h>
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 #include <mbedtls/sha256.h>
 // #ifdef SOC_HMAC_SUPPORTED
 // #include <esp_hmac.h>
 // #endif
 #include <cstring>
+#include <cstdio>
 #include <vector>
 #include <sstream>
 #include <algorithm>
 
+// esp_ota_resume is only available since ESP-IDF v5.5, older versions retry an
+// interrupted download within the same upgrade but start over after a reboot
+#define OTA_RESUME_SUPPORTED (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 5, 0))
+
 #define TAG "OTA"
 
 // Secret key for SHA256 verification (must match server's SECRET_KEY)
@@ -86,6 +96,31 @@ std::unique_ptr<Http> Ota::SetupHttp() {
     return http;
 }
 
+// Parse an IMF-fixdate such as "Sun, 06 Nov 1994 08:49:37 GMT" into milliseconds since the epoch,
+// returns 0 if the header is missing or malformed
+static int64_t ParseHttpDate(const std::string& date) {
+    static const char* kMonths = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4] = {0};
+    int day, year, hour, minute, second;
+    if (sscanf(date.c_str(), "%*3s, %d %3s %d %d:%d:%d GMT", &day, month, &year, &hour, &minute, &second) != 6) {
+        return 0;
+    }
+    const char* found = strstr(kMonths, month);
+    if (strlen(month) != 3 || found == nullptr || (found - kMonths) % 3 != 0 || year < 1970) {
+        return 0;
+    }
+    int m = (found - kMonths) / 3 + 1;
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    int y = year - (m <= 2);
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    return ((days * 24 + hour) * 60 + minute) * 60000LL + second * 1000LL;
+}
+
 /* 
  * Specification: https://ccnphfhqs21z.feishu.cn/wiki/FjW6wZmisimNBBkov6OcmfvknVd
  */
@@ -111,6 +146,13 @@ esp_err_t Ota::CheckVersion() {
     }
 
     auto http = SetupHttp();
+    std::string cached_response = Settings("ota", false).GetString("response");
+    if (!cached_response.empty()) {
+        auto etag = Settings("ota", false).GetString("etag");
+        if (!etag.empty()) {
+            http->SetHeader("If-None-Match", etag);
+        }
+    }
 
     std::string data = board.GetSystemInfoJson();
     std::string method = data.length() > 0 ? "POST" : "GET";
@@ -122,16 +164,54 @@ esp_err_t Ota::CheckVersion() {
         return last_error;
     }
 
+    // 304 means the response cached by the last check is still current
     auto status_code = http->GetStatusCode();
+    if (status_code == 304 && !cached_response.empty()) {
+        auto date = http->GetResponseHeader("Date");
+        http->Close();
+        ESP_LOGI(TAG, "Version check not modified, using the cached response");
+        return ParseResponse(cached_response, true, ParseHttpDate(date));
+    }
     if (status_code != 200) {
         ESP_LOGE(TAG, "Failed to check version, status code: %d", status_code);
         return status_code;
     }
 
     data = http->ReadAll();
+    auto etag = http->GetResponseHeader("ETag");
     http->Close();
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+    esp_err_t err = ParseResponse(data, false);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Only a response that lets an activated device connect is worth starting from
+    Settings cache("ota", true);
+    if ((has_mqtt_config_ || has_websocket_config_) && !has_activation_code_ && !has_activation_challenge_ &&
+        data.size() <= kMaxCachedResponseSize) {
+        if (cached_response != data) {
+            cache.SetString("response", data);
+        }
+        cache.SetString("etag", etag);
+    } else {
+        cache.EraseKey("response");
+        cache.EraseKey("etag");
+    }
+    return ESP_OK;
+}
+
+bool Ota::LoadCachedResponse() {
+    current_version_ = esp_app_get_description()->version;
+    auto data = Settings("ota", false).GetString("response");
+    if (data.empty() || ParseResponse(data, true) != ESP_OK) {
+        return false;
+    }
+    return has_mqtt_config_ || has_websocket_config_;
+}
+
+esp_err_t Ota::ParseResponse(const std::string& data, bool cached, int64_t date_ms) {
+    // Response: { "firmware": { "version": "1.0.0", "url": "http://", "delta_url": "http://" } }
     // Parse the JSON response and check if the version is newer
     // If it is, set has_new_version_ to true and store the new version and URL
     
@@ -207,30 +287,34 @@ esp_err_t Ota::CheckVersion() {
         ESP_LOGI(TAG, "No websocket section found!");
     }
 
+    // The timestamp in a cached response is out of date, the caller passes the Date header
+    // of the 304 instead and the time zone of the cached response still applies
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
-    if (cJSON_IsObject(server_time)) {
-        cJSON *timestamp = cJSON_GetObjectItem(server_time, "timestamp");
-        cJSON *timezone_offset = cJSON_GetObjectItem(server_time, "timezone_offset");
-        
-        if (cJSON_IsNumber(timestamp)) {
-            // 设置系统时间
-            struct timeval tv;
-            double ts = timestamp->valuedouble;
-            
-            // 如果有时区偏移，计算本地时间
-            if (cJSON_IsNumber(timezone_offset)) {
-                ts += (timezone_offset->valueint * 60 * 1000); // 转换分钟为毫秒
-            }
-            
-            tv.tv_sec = (time_t)(ts / 1000);  // 转换毫秒为秒
-            tv.tv_usec = (suseconds_t)((long long)ts % 1000) * 1000;  // 剩余的毫秒转换为微秒
-            settimeofday(&tv, NULL);
-            has_server_time_ = true;
-        }
+    cJSON *timestamp = cJSON_GetObjectItem(server_time, "timestamp");
+    cJSON *timezone_offset = cJSON_GetObjectItem(server_time, "timezone_offset");
+    double ts = 0;
+    if (!cached && cJSON_IsNumber(timestamp)) {
+        ts = timestamp->valuedouble;
+    } else if (cached) {
+        ts = date_ms;
     } else {
         ESP_LOGW(TAG, "No server_time section found!");
     }
+    if (ts > 0) {
+        // 设置系统时间
+        struct timeval tv;
+
+        // 如果有时区偏移，计算本地时间
+        if (cJSON_IsNumber(timezone_offset)) {
+            ts += (timezone_offset->valueint * 60 * 1000); // 转换分钟为毫秒
+        }
+
+        tv.tv_sec = (time_t)(ts / 1000);  // 转换毫秒为秒
+        tv.tv_usec = (suseconds_t)((long long)ts % 1000) * 1000;  // 剩余的毫秒转换为微秒
+        settimeofday(&tv, NULL);
+        has_server_time_ = true;
+    }
 
     has_new_version_ = false;
     cJSON *firmware = cJSON_GetObjectItem(root, "firmware");
@@ -243,6 +327,12 @@ esp_err_t Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // A patch against the running image, offered by the server for the version we reported
+        firmware_delta_url_.clear();
+        cJSON *delta_url = cJSON_GetObjectItem(firmware, "delta_url");
+        if (cJSON_IsString(delta_url)) {
+            firmware_delta_url_ = delta_url->valuestring;
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -286,100 +376,534 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
-bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback) {
-    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
-    auto update_partition = esp_ota_get_next_update_partition(NULL);
-    if (update_partition == NULL) {
-        ESP_LOGE(TAG, "Failed to get update partition");
+// Checks the application description at the start of the image before anything is written
+static bool CheckImageHeader(const char* data, size_t length, esp_app_desc_t& new_app_info) {
+    if (length < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+        ESP_LOGE(TAG, "The firmware image is too small");
         return false;
     }
+    memcpy(&new_app_info, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+    auto current_version = esp_app_get_description()->version;
+    ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
+    return true;
+}
 
-    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
+static std::string GetImageDigest(const esp_app_desc_t& app_info) {
+    char hex[sizeof(app_info.app_elf_sha256) * 2 + 1];
+    for (size_t i = 0; i < sizeof(app_info.app_elf_sha256); i++) {
+        snprintf(hex + i * 2, 3, "%02x", app_info.app_elf_sha256[i]);
+    }
+    return hex;
+}
+
+void Ota::ClearDownloadProgress() {
+    Settings settings("ota", true);
+    settings.EraseKey("dl_url");
+    settings.EraseKey("dl_partition");
+    settings.EraseKey("dl_length");
+    settings.EraseKey("dl_offset");
+    settings.EraseKey("dl_digest");
+    settings.Commit();
+}
+
+/*
+ * The network is read into one buffer while a writer task passes the other one to
+ * esp_ota_write, so TLS reads and flash erase/write overlap. On success the OTA
+ * handle is left open for the caller to end or abort.
+ *
+ * The written offset (at a sector boundary) is saved in NVS together with the URL,
+ * the update partition and the ELF SHA-256 from the image header. An interrupted
+ * download is retried, and a later call for the same URL continues with an HTTP
+ * Range request through esp_ota_resume (ESP-IDF v5.5 and later), if the header in
+ * the partition still carries the same digest. esp_ota_end validates the whole
+ * image afterwards.
+ */
+bool Ota::DownloadImage(const std::string& url, const esp_partition_t* partition, esp_ota_handle_t& update_handle,
+    std::function<void(int progress, size_t speed, size_t flash_speed)> callback) {
+    Settings settings("ota", true);
+    size_t content_length = 0;
+    size_t received = 0;
+#if OTA_RESUME_SUPPORTED
+    if (settings.GetString("dl_url") == url && settings.GetString("dl_partition") == partition->label) {
+        content_length = settings.GetInt("dl_length");
+        received = settings.GetInt("dl_offset");
+        esp_app_desc_t written_app_info;
+        if (content_length == 0 || received == 0 || received >= content_length ||
+            esp_ota_get_partition_description(partition, &written_app_info) != ESP_OK ||
+            GetImageDigest(written_app_info) != settings.GetString("dl_digest")) {
+            content_length = 0;
+            received = 0;
+        } else {
+            ESP_LOGI(TAG, "Resuming firmware download at %u/%u", received, content_length);
+        }
+    }
+#endif
+
+    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
+    const size_t PROGRESS_INTERVAL = 64 * 1024;
+    size_t write_offset = received;
+    size_t saved_offset = received;
+    FlashWritePipeline pipeline(CONFIG_OTA_BUFFER_SIZE, 2, [&](const char* data, size_t length) {
+        auto err = esp_ota_write(update_handle, data, length);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+            return false;
+        }
+        write_offset += length;
+        // Only whole sectors are recorded, esp_ota_resume erases from the saved offset on
+        if (write_offset - saved_offset >= PROGRESS_INTERVAL) {
+            saved_offset = write_offset / SECTOR_SIZE * SECTOR_SIZE;
+            settings.SetInt("dl_offset", saved_offset);
+            settings.Commit();
+        }
+        return true;
+    });
 
+    bool ota_begun = false;
+#if OTA_RESUME_SUPPORTED
+    if (received > 0) {
+        if (esp_ota_resume(partition, OTA_WITH_SEQUENTIAL_WRITES, received, &update_handle) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to resume OTA, starting over");
+            content_length = 0;
+            received = write_offset = saved_offset = 0;
+        } else {
+            ota_begun = true;
+        }
+    }
+#endif
+
+    const int MAX_RETRIES = 3;
     auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t start_offset = received;
+    size_t recent_read = 0;
+    bool pipeline_started = false;
+    bool completed = false;
+    bool fatal = false;
+    for (int attempt = 0; attempt <= MAX_RETRIES && !completed && !fatal && !pipeline.failed(); attempt++) {
+        if (attempt > 0) {
+            ESP_LOGW(TAG, "Firmware download interrupted at %u/%u, retrying (%d/%d)", received, content_length, attempt, MAX_RETRIES);
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+
+        auto http = network->CreateHttp(0);
+        if (received > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(received) + "-");
+        }
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+            continue;
+        }
+
+        // A server without Range support answers 200, the part already written is skipped
+        int status_code = http->GetStatusCode();
+        size_t skip = 0;
+        size_t total_length = 0;
+        if (status_code == 206 && received > 0) {
+            total_length = received + http->GetBodyLength();
+        } else if (status_code == 200) {
+            skip = received;
+            total_length = http->GetBodyLength();
+        } else {
+            ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
+            fatal = true;
+            break;
+        }
+
+        if (content_length != 0 && total_length != content_length) {
+            if (pipeline_started || start_offset == 0) {
+                ESP_LOGE(TAG, "Firmware size changed during download: %u -> %u", content_length, total_length);
+                fatal = true;
+                break;
+            }
+            // The saved progress belongs to another image, start over
+            ESP_LOGW(TAG, "Firmware size changed from %u to %u, restarting download", content_length, total_length);
+            http->Close();
+            esp_ota_abort(update_handle);
+            ota_begun = false;
+            content_length = 0;
+            received = write_offset = saved_offset = start_offset = 0;
+            attempt--;
+            continue;
+        }
+
+        if (content_length == 0) {
+            content_length = total_length;
+            if (content_length == 0) {
+                ESP_LOGE(TAG, "Failed to get content length");
+                fatal = true;
+                break;
+            }
+            if (content_length > partition->size) {
+                ESP_LOGE(TAG, "Firmware size (%u) is larger than partition size (%lu)", content_length, partition->size);
+                fatal = true;
+                break;
+            }
+        }
+        if (!pipeline_started) {
+            if (!pipeline.Start("ota_write")) {
+                fatal = true;
+                break;
+            }
+            pipeline_started = true;
+        }
+
+        int ret = 0;
+        while (received < content_length && !pipeline.failed()) {
+            char* buffer = pipeline.AcquireBuffer();
+            size_t filled = 0;
+            while (filled < pipeline.buffer_size() && received + filled < content_length) {
+                size_t to_read = std::min(pipeline.buffer_size() - filled, content_length - received - filled);
+                ret = http->Read(buffer + filled, skip > 0 ? std::min(to_read, skip) : to_read);
+                if (ret <= 0) {
+                    break;
+                }
+                if (skip > 0) {
+                    skip -= ret;
+                    continue;
+                }
+                filled += ret;
+            }
+
+            // The first buffer holds the image header, the partition is not touched before it is checked
+            if (!ota_begun && filled > 0) {
+                esp_app_desc_t new_app_info;
+                if (!CheckImageHeader(buffer, filled, new_app_info) ||
+                    esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to begin OTA");
+                    pipeline.Submit(buffer, 0);
+                    fatal = true;
+                    break;
+                }
+                ota_begun = true;
+                settings.SetString("dl_url", url);
+                settings.SetString("dl_partition", partition->label);
+                settings.SetInt("dl_length", content_length);
+                settings.SetInt("dl_offset", 0);
+                settings.SetString("dl_digest", GetImageDigest(new_app_info));
+                settings.Commit();
+            }
+            pipeline.Submit(buffer, filled);
+            received += filled;
+            recent_read += filled;
+
+            // Calculate speed and progress every second
+            auto now = esp_timer_get_time();
+            if (now - last_calc_time >= 1000000 || received == content_length) {
+                size_t progress = received * 100 / content_length;
+                size_t speed = recent_read * 1000000 / std::max<int64_t>(now - last_calc_time, 1);
+                size_t flash_speed = pipeline.written_bytes() * 1000000 / std::max<int64_t>(pipeline.flash_busy_us(), 1);
+                ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Network: %uB/s, Flash: %uB/s", progress, received, content_length,
+                    speed, flash_speed);
+                if (callback) {
+                    callback(progress, speed, flash_speed);
+                }
+                last_calc_time = now;
+                recent_read = 0;
+            }
+
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+                break;
+            }
+            if (ret == 0 && received < content_length) {
+                ESP_LOGE(TAG, "Connection closed at %u/%u", received, content_length);
+                break;
+            }
+        }
+        http->Close();
+        completed = received == content_length;
+    }
+
+    bool written = pipeline_started && pipeline.Finish();
+    auto elapsed_us = std::max<int64_t>(esp_timer_get_time() - start_time, 1);
+    ESP_LOGI(TAG, "Downloaded %u bytes in %d ms, %u KB/s; flash busy %d ms, waiting for flash %d ms",
+        received - start_offset, int(elapsed_us / 1000), size_t((received - start_offset) * 1000000ULL / elapsed_us / 1024),
+        int(pipeline.flash_busy_us() / 1000), int(pipeline.wait_us() / 1000));
+    if (!ota_begun) {
+        return false;
+    }
+    if (!completed || !written) {
+        // The progress saved so far stays in NVS for the next attempt
+        ESP_LOGE(TAG, "Failed to download firmware, %u/%u bytes written", write_offset, content_length);
+        esp_ota_abort(update_handle);
         return false;
     }
+    return true;
+}
 
+/*
+ * Firmware delta patch, all integers little-endian:
+ *   header    firmware_patch_header
+ *   commands  until FIRMWARE_PATCH_END
+ *     COPY    src, length                  length bytes of the base image at src
+ *     ADD     src, length, stored, data    base[src + i] + diff[i] for length bytes
+ *     INSERT  length, stored, data         length new bytes
+ * ADD and INSERT carry at most FIRMWARE_PATCH_CHUNK bytes each; when stored < length
+ * the data is an LZ4 block. Patches are made by scripts/firmware_delta.py.
+ */
+#define FIRMWARE_PATCH_MAGIC 0x50465A58  // "XZFP"
+#define FIRMWARE_PATCH_VERSION 1
+#define FIRMWARE_PATCH_CHUNK 4096
+
+enum FirmwarePatchCommand : uint8_t {
+    FIRMWARE_PATCH_END = 0,
+    FIRMWARE_PATCH_COPY = 1,
+    FIRMWARE_PATCH_ADD = 2,
+    FIRMWARE_PATCH_INSERT = 3,
+};
+
+struct firmware_patch_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t target_size;
+    uint8_t base_sha256[32];    // Image digest of the running partition, see esp_partition_get_sha256
+    uint8_t target_sha256[32];  // SHA-256 of the whole target image
+};
+
+/*
+ * Builds the new image from the running partition and the patch, streaming both, so
+ * RAM use is the two write buffers plus three FIRMWARE_PATCH_CHUNK buffers. Returns
+ * false when the patch does not belong to the running image or the result does not
+ * match the target digest; on success the OTA handle is left open like DownloadImage.
+ */
+bool Ota::ApplyDelta(const std::string& url, const esp_partition_t* partition, esp_ota_handle_t& update_handle,
+    std::function<void(int progress, size_t speed, size_t flash_speed)> callback) {
+    auto running_partition = esp_ota_get_running_partition();
+    uint8_t base_sha256[32];
+    if (esp_partition_get_sha256(running_partition, base_sha256) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get the digest of the running image");
+        return false;
+    }
+
+    auto http = Board::GetInstance().GetNetwork()->CreateHttp(0);
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
     if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+        ESP_LOGE(TAG, "Failed to get firmware delta, status code: %d", http->GetStatusCode());
+        return false;
+    }
+    size_t patch_length = http->GetBodyLength();
+    size_t patch_read = 0;
+    auto read_patch = [&http, &patch_read](void* data, size_t length) {
+        size_t filled = 0;
+        while (filled < length) {
+            int ret = http->Read((char*)data + filled, length - filled);
+            if (ret <= 0) {
+                ESP_LOGE(TAG, "Failed to read firmware delta at %u", patch_read + filled);
+                return false;
+            }
+            filled += ret;
+        }
+        patch_read += length;
+        return true;
+    };
+
+    firmware_patch_header header;
+    if (!read_patch(&header, sizeof(header))) {
+        return false;
+    }
+    if (header.magic != FIRMWARE_PATCH_MAGIC || header.version != FIRMWARE_PATCH_VERSION) {
+        ESP_LOGE(TAG, "Invalid firmware delta");
+        return false;
+    }
+    if (memcmp(header.base_sha256, base_sha256, sizeof(base_sha256)) != 0) {
+        ESP_LOGW(TAG, "The firmware delta was made for another base image");
+        return false;
+    }
+    if (header.target_size > partition->size) {
+        ESP_LOGE(TAG, "Firmware size (%lu) is larger than partition size (%lu)", header.target_size, partition->size);
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    // The delta writes the partition from the start, a saved full download is no longer valid
+    ClearDownloadProgress();
+    if (esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to begin OTA");
         return false;
     }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+    FlashWritePipeline pipeline(CONFIG_OTA_BUFFER_SIZE, 2, [&update_handle](const char* data, size_t length) {
+        auto err = esp_ota_write(update_handle, data, length);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
             return false;
         }
+        return true;
+    });
+    auto work = (uint8_t*)heap_caps_malloc(3 * FIRMWARE_PATCH_CHUNK, MALLOC_CAP_8BIT);
+    if (work == nullptr || !pipeline.Start("ota_write")) {
+        ESP_LOGE(TAG, "Failed to allocate firmware delta buffers");
+        heap_caps_free(work);
+        esp_ota_abort(update_handle);
+        return false;
+    }
+    uint8_t* base = work;
+    uint8_t* data = work + FIRMWARE_PATCH_CHUNK;
+    uint8_t* stored = work + 2 * FIRMWARE_PATCH_CHUNK;
 
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (callback) {
-                callback(progress, recent_read);
+    mbedtls_sha256_context sha256_ctx;
+    mbedtls_sha256_init(&sha256_ctx);
+    mbedtls_sha256_starts(&sha256_ctx, 0);
+
+    size_t target_written = 0;
+    char* buffer = pipeline.AcquireBuffer();
+    size_t buffer_used = 0;
+    auto emit = [&](const uint8_t* bytes, size_t length) {
+        if (length > header.target_size - target_written) {
+            ESP_LOGE(TAG, "Firmware delta writes past the target size");
+            return false;
+        }
+        mbedtls_sha256_update(&sha256_ctx, bytes, length);
+        target_written += length;
+        while (length > 0) {
+            size_t n = std::min(length, pipeline.buffer_size() - buffer_used);
+            memcpy(buffer + buffer_used, bytes, n);
+            buffer_used += n;
+            bytes += n;
+            length -= n;
+            if (buffer_used == pipeline.buffer_size()) {
+                pipeline.Submit(buffer, buffer_used);
+                buffer = pipeline.AcquireBuffer();
+                buffer_used = 0;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
         }
+        return !pipeline.failed();
+    };
+    auto read_base = [running_partition](uint32_t src, uint8_t* dst, size_t length) {
+        if (src > running_partition->size || length > running_partition->size - src) {
+            ESP_LOGE(TAG, "Firmware delta reads past the base image");
+            return false;
+        }
+        return esp_partition_read(running_partition, src, dst, length) == ESP_OK;
+    };
+    // ADD and INSERT data, decompressed into data
+    auto read_chunk = [&](uint32_t length) {
+        uint32_t stored_length;
+        if (length > FIRMWARE_PATCH_CHUNK || !read_patch(&stored_length, sizeof(stored_length)) ||
+            stored_length > length) {
+            ESP_LOGE(TAG, "Invalid firmware delta chunk");
+            return false;
+        }
+        if (stored_length == length) {
+            return read_patch(data, length);
+        }
+        return read_patch(stored, stored_length) && Lz4DecompressBlock(stored, stored_length, data, length);
+    };
 
-        if (ret == 0) {
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t last_read = 0;
+    bool ok = true;
+    while (ok) {
+        uint8_t command;
+        uint32_t args[2];
+        if (!read_patch(&command, sizeof(command))) {
+            ok = false;
             break;
         }
+        if (command == FIRMWARE_PATCH_END) {
+            break;
+        } else if (command == FIRMWARE_PATCH_COPY) {
+            ok = read_patch(args, 2 * sizeof(uint32_t));
+            for (uint32_t done = 0; ok && done < args[1]; done += FIRMWARE_PATCH_CHUNK) {
+                size_t n = std::min<size_t>(args[1] - done, FIRMWARE_PATCH_CHUNK);
+                ok = read_base(args[0] + done, base, n) && emit(base, n);
+            }
+        } else if (command == FIRMWARE_PATCH_ADD) {
+            ok = read_patch(args, 2 * sizeof(uint32_t)) && read_chunk(args[1]) && read_base(args[0], base, args[1]);
+            if (ok) {
+                for (uint32_t i = 0; i < args[1]; i++) {
+                    data[i] += base[i];
+                }
+                ok = emit(data, args[1]);
+            }
+        } else if (command == FIRMWARE_PATCH_INSERT) {
+            ok = read_patch(args, sizeof(uint32_t)) && read_chunk(args[0]) && emit(data, args[0]);
+        } else {
+            ESP_LOGE(TAG, "Unknown firmware delta command %u", command);
+            ok = false;
+        }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
+        // Calculate speed and progress every second
+        auto now = esp_timer_get_time();
+        if (now - last_calc_time >= 1000000) {
+            size_t progress = (uint64_t)target_written * 100 / std::max<uint32_t>(header.target_size, 1);
+            size_t speed = (patch_read - last_read) * 1000000 / (now - last_calc_time);
+            size_t flash_speed = pipeline.written_bytes() * 1000000 / std::max<int64_t>(pipeline.flash_busy_us(), 1);
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%lu), Delta: %u/%u, Network: %uB/s, Flash: %uB/s", progress, target_written,
+                header.target_size, patch_read, patch_length, speed, flash_speed);
+            if (callback) {
+                callback(progress, speed, flash_speed);
+            }
+            last_calc_time = now;
+            last_read = patch_read;
+        }
+    }
+    http->Close();
+    pipeline.Submit(buffer, buffer_used);
+    bool written = pipeline.Finish();
+    heap_caps_free(work);
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
+    uint8_t target_sha256[32];
+    mbedtls_sha256_finish(&sha256_ctx, target_sha256);
+    mbedtls_sha256_free(&sha256_ctx);
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+    auto elapsed_us = std::max<int64_t>(esp_timer_get_time() - start_time, 1);
+    ESP_LOGI(TAG, "Applied %u bytes of delta into %u bytes in %d ms", patch_read, target_written, int(elapsed_us / 1000));
+    if (!ok || !written || target_written != header.target_size ||
+        memcmp(target_sha256, header.target_sha256, sizeof(target_sha256)) != 0) {
+        ESP_LOGE(TAG, "The patched firmware does not match the target image");
+        esp_ota_abort(update_handle);
+        return false;
+    }
+    return true;
+}
+
+bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed, size_t flash_speed)> callback,
+    const std::string& delta_url) {
+    ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
+    esp_ota_handle_t update_handle = 0;
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
+    esp_err_t err = ESP_FAIL;
+    if (!delta_url.empty()) {
+        ESP_LOGI(TAG, "Applying firmware delta from %s", delta_url.c_str());
+        if (ApplyDelta(delta_url, update_partition, update_handle, callback)) {
+            err = esp_ota_end(update_handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "The patched image is not valid: %s", esp_err_to_name(err));
             }
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return false;
+            ESP_LOGW(TAG, "Firmware delta failed, downloading the full image");
         }
     }
-    http->Close();
 
-    esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
-        } else {
-            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+        if (!DownloadImage(firmware_url, update_partition, update_handle, callback)) {
+            return false;
+        }
+
+        // The resumed image is validated as a whole, a corrupted one is downloaded again from the start
+        err = esp_ota_end(update_handle);
+        ClearDownloadProgress();
+        if (err != ESP_OK) {
+            if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+                ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+            } else {
+                ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+            }
+            return false;
         }
-        return false;
     }
 
     err = esp_ota_set_boot_partition(update_partition);
@@ -392,8 +916,62 @@ bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progre
     return true;
 }
 
-bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
-    return Upgrade(firmware_url_, callback);
+#if CONFIG_OTA_UPGRADE_BENCHMARK
+/*
+ * Downloads the image into the update partition twice without installing it: first with
+ * the previous loop (512 byte reads and esp_ota_write in turn), then with DownloadImage.
+ * Returns {"buffer_size":..,"legacy":{"bytes":..,"ms":..},"pipelined":{"ok":..,"ms":..}}
+ */
+std::string Ota::RunUpgradeBenchmark(const std::string& firmware_url) {
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        return "{\"error\":\"No update partition\"}";
+    }
+
+    // Legacy loop
+    size_t legacy_bytes = 0;
+    auto start_time = esp_timer_get_time();
+    {
+        auto http = Board::GetInstance().GetNetwork()->CreateHttp(0);
+        esp_ota_handle_t update_handle = 0;
+        if (http->Open("GET", firmware_url) && http->GetStatusCode() == 200 &&
+            esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) == ESP_OK) {
+            char buffer[512];
+            int ret;
+            while ((ret = http->Read(buffer, sizeof(buffer))) > 0) {
+                if (esp_ota_write(update_handle, buffer, ret) != ESP_OK) {
+                    break;
+                }
+                legacy_bytes += ret;
+            }
+            esp_ota_abort(update_handle);
+        }
+        http->Close();
+    }
+    int legacy_ms = (esp_timer_get_time() - start_time) / 1000;
+
+    // Pipelined, always from the start
+    ClearDownloadProgress();
+    start_time = esp_timer_get_time();
+    esp_ota_handle_t update_handle = 0;
+    bool pipelined_ok = DownloadImage(firmware_url, update_partition, update_handle, nullptr);
+    if (pipelined_ok) {
+        esp_ota_abort(update_handle);
+    }
+    ClearDownloadProgress();
+    int pipelined_ms = (esp_timer_get_time() - start_time) / 1000;
+
+    ESP_LOGI(TAG, "Upgrade benchmark: legacy %u bytes in %d ms, pipelined (%d byte buffers) %s in %d ms",
+        legacy_bytes, legacy_ms, CONFIG_OTA_BUFFER_SIZE, pipelined_ok ? "done" : "failed", pipelined_ms);
+    char json[160];
+    snprintf(json, sizeof(json), "{\"buffer_size\":%d,\"legacy\":{\"bytes\":%u,\"ms\":%d},\"pipelined\":{\"ok\":%s,\"ms\":%d}}",
+        CONFIG_OTA_BUFFER_SIZE, legacy_bytes, legacy_ms, pipelined_ok ? "true" : "false", pipelined_ms);
+    return json;
+}
+#endif
+
+bool Ota::StartUpgrade(std::function<void(int progress, size_t speed, size_t flash_speed)> callback) {
+    return Upgrade(firmware_url_, callback, firmware_delta_url_);
 }
 
 
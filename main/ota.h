@@ -5,14 +5,19 @@
 #include <string>
 
 #include <esp_err.h>
+#include <esp_ota_ops.h>
 #include "board.h"
 
 class Ota {
 public:
+    static constexpr size_t kMaxCachedResponseSize = 3072;
+
     Ota();
     ~Ota();
 
     esp_err_t CheckVersion();
+    // Restores the response of the last successful version check, true if it has a protocol config
+    bool LoadCachedResponse();
     esp_err_t Activate();
     bool HasActivationChallenge() { return has_activation_challenge_; }
     bool HasNewVersion() { return has_new_version_; }
@@ -20,13 +25,19 @@ public:
     bool HasWebsocketConfig() { return has_websocket_config_; }
     bool HasActivationCode() { return has_activation_code_; }
     bool HasServerTime() { return has_server_time_; }
-    bool StartUpgrade(std::function<void(int progress, size_t speed)> callback);
-    static bool Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed)> callback);
+    bool StartUpgrade(std::function<void(int progress, size_t speed, size_t flash_speed)> callback);
+    // delta_url is tried first when given, the full image at firmware_url is the fall-back
+    static bool Upgrade(const std::string& firmware_url, std::function<void(int progress, size_t speed, size_t flash_speed)> callback,
+        const std::string& delta_url = "");
     void MarkCurrentVersionValid();
+#if CONFIG_OTA_UPGRADE_BENCHMARK
+    static std::string RunUpgradeBenchmark(const std::string& firmware_url);
+#endif
 
     const std::string& GetFirmwareVersion() const { return firmware_version_; }
     const std::string& GetCurrentVersion() const { return current_version_; }
     const std::string& GetFirmwareUrl() const { return firmware_url_; }
+    const std::string& GetFirmwareDeltaUrl() const { return firmware_delta_url_; }
     const std::string& GetActivationMessage() const { return activation_message_; }
     const std::string& GetActivationCode() const { return activation_code_; }
     std::string GetCheckVersionUrl();
@@ -44,15 +55,22 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_delta_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
-    std::function<void(int progress, size_t speed)> upgrade_callback_;
+    std::function<void(int progress, size_t speed, size_t flash_speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
     std::string GetActivationPayload();
+    esp_err_t ParseResponse(const std::string& data, bool cached, int64_t date_ms = 0);
     std::unique_ptr<Http> SetupHttp();
+    static void ClearDownloadProgress();
+    static bool DownloadImage(const std::string& url, const esp_partition_t* partition, esp_ota_handle_t& update_handle,
+        std::function<void(int progress, size_t speed, size_t flash_speed)> callback);
+    static bool ApplyDelta(const std::string& url, const esp_partition_t* partition, esp_ota_handle_t& update_handle,
+        std::function<void(int progress, size_t speed, size_t flash_speed)> callback);
 };
 
 #endif // _OTA_H
@@ -0,0 +1,102 @@
+#include "json_writer.h"
+
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <cinttypes>
+#include <mbedtls/base64.h>
+
+JsonWriter::JsonWriter(char* buffer, size_t capacity, Sink sink)
+    : buffer_(buffer), capacity_(capacity), sink_(std::move(sink)) {
+}
+
+void JsonWriter::Flush(bool last) {
+    if (ok_ && (length_ > 0 || last)) {
+        ok_ = sink_(buffer_, length_, last);
+    }
+    bytes_written_ += length_;
+    length_ = 0;
+}
+
+void JsonWriter::Raw(const char* data, size_t length) {
+    while (length > 0) {
+        if (length_ == capacity_) {
+            Flush(false);
+        }
+        size_t n = std::min(length, capacity_ - length_);
+        memcpy(buffer_ + length_, data, n);
+        length_ += n;
+        data += n;
+        length -= n;
+    }
+}
+
+void JsonWriter::Raw(const char* str) {
+    Raw(str, strlen(str));
+}
+
+void JsonWriter::String(const char* str) {
+    String(str, strlen(str));
+}
+
+void JsonWriter::String(const char* data, size_t length) {
+    Put('"');
+    StringContent(data, length);
+    Put('"');
+}
+
+void JsonWriter::StringContent(const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        switch (c) {
+            case '"': Put('\\'); Put('"'); break;
+            case '\\': Put('\\'); Put('\\'); break;
+            case '\n': Put('\\'); Put('n'); break;
+            case '\r': Put('\\'); Put('r'); break;
+            case '\t': Put('\\'); Put('t'); break;
+            case '\b': Put('\\'); Put('b'); break;
+            case '\f': Put('\\'); Put('f'); break;
+            default:
+                if (c < 0x20) {
+                    char escaped[7];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    Raw(escaped, 6);
+                } else {
+                    Put(static_cast<char>(c));
+                }
+                break;
+        }
+    }
+}
+
+void JsonWriter::Int(int64_t value) {
+    char number[24];
+    int n = snprintf(number, sizeof(number), "%" PRId64, value);
+    Raw(number, n);
+}
+
+void JsonWriter::Bool(bool value) {
+    Raw(value ? "true" : "false");
+}
+
+void JsonWriter::Base64(const uint8_t* data, size_t length) {
+    // Encode in blocks that are a multiple of 3 bytes so no padding appears mid-stream
+    const size_t kBlockSize = 192;
+    unsigned char encoded[kBlockSize / 3 * 4 + 1];
+    while (length > 0) {
+        size_t n = std::min(length, kBlockSize);
+        size_t olen = 0;
+        if (mbedtls_base64_encode(encoded, sizeof(encoded), &olen, data, n) != 0) {
+            ok_ = false;
+            return;
+        }
+        Raw(reinterpret_cast<const char*>(encoded), olen);
+        data += n;
+        length -= n;
+    }
+}
+
+bool JsonWriter::Finish() {
+    Flush(true);
+    return ok_;
+}
@@ -0,0 +1,64 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Streaming JSON writer over a fixed chunk buffer.
+ * Output is handed to the sink each time the buffer fills up, so arbitrarily
+ * large documents (e.g. base64 images) never need a contiguous allocation.
+ * The caller is responsible for emitting well-formed JSON structure.
+ */
+class JsonWriter {
+public:
+    // Receives each filled chunk; last is true for the final chunk of the document
+    using Sink = std::function<bool(const char* data, size_t length, bool last)>;
+
+    JsonWriter(char* buffer, size_t capacity, Sink sink);
+
+    // Append raw, already valid JSON text
+    void Raw(const char* data, size_t length);
+    void Raw(const char* str);
+    void Raw(const std::string& str) { Raw(str.data(), str.size()); }
+
+    // Append a quoted, escaped JSON string
+    void String(const char* str);
+    void String(const std::string& str) { String(str.data(), str.size()); }
+    void String(const char* data, size_t length);
+
+    // Append escaped string content without the surrounding quotes
+    void StringContent(const char* data, size_t length);
+
+    void Int(int64_t value);
+    void Bool(bool value);
+
+    // Append the base64 encoding of data (without quotes)
+    void Base64(const uint8_t* data, size_t length);
+
+    // Flush the remaining bytes as the last chunk. Returns false if any sink call failed.
+    bool Finish();
+
+    inline bool ok() const { return ok_; }
+    inline size_t bytes_written() const { return bytes_written_; }
+
+private:
+    char* buffer_;
+    size_t capacity_;
+    size_t length_ = 0;
+    size_t bytes_written_ = 0;
+    bool ok_ = true;
+    Sink sink_;
+
+    void Flush(bool last);
+    inline void Put(char c) {
+        if (length_ == capacity_) {
+            Flush(false);
+        }
+        buffer_[length_++] = c;
+    }
+};
+
+#endif // JSON_WRITER_H
@@ -78,6 +78,40 @@ void Protocol::SendMcpMessage(const std::string& payload) {
     SendText(message);
 }
 
+bool Protocol::SendMcpMessage(const std::function<void(JsonWriter& writer)>& write_payload) {
+    if (!mcp_fragment_buffer_) {
+        mcp_fragment_buffer_ = std::make_unique<char[]>(kMcpFragmentSize);
+    }
+    JsonWriter writer(mcp_fragment_buffer_.get(), kMcpFragmentSize, [this](const char* data, size_t length, bool last) {
+        return SendTextFragment(data, length, last);
+    });
+    writer.Raw("{\"session_id\":");
+    writer.String(session_id_);
+    writer.Raw(",\"type\":\"mcp\",\"payload\":");
+    write_payload(writer);
+    writer.Raw("}");
+    bool success = writer.Finish();
+    if (!success) {
+        ESP_LOGE(TAG, "Failed to send MCP message (%u bytes)", writer.bytes_written());
+        AbortTextFragments();
+    }
+    return success;
+}
+
+bool Protocol::SendTextFragment(const char* data, size_t length, bool last) {
+    pending_fragments_.append(data, length);
+    if (!last) {
+        return true;
+    }
+    bool success = SendText(pending_fragments_);
+    std::string().swap(pending_fragments_);
+    return success;
+}
+
+void Protocol::AbortTextFragments() {
+    std::string().swap(pending_fragments_);
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
@@ -6,6 +6,9 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <memory>
+
+#include "json_writer.h"
 
 enum class AudioPayloadFormat {
     kAudioPayloadFormatOpus,
@@ -79,6 +82,8 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // Stream an MCP payload without building it in memory first
+    bool SendMcpMessage(const std::function<void(JsonWriter& writer)>& write_payload);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -96,8 +101,19 @@ protected:
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
+    // Send one fragment of a text message. The default implementation assembles
+    // the fragments and sends them with SendText() when the last one arrives.
+    virtual bool SendTextFragment(const char* data, size_t length, bool last);
+    // Drop a fragmented message that will not be finished
+    virtual void AbortTextFragments();
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
+
+private:
+    // Reusable chunk buffer for streamed MCP messages
+    static constexpr size_t kMcpFragmentSize = 2048;
+    std::unique_ptr<char[]> mcp_fragment_buffer_;
+    std::string pending_fragments_;
 };
 
 #endif // PROTOCOL_H
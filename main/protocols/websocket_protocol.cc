@@ -34,6 +34,8 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         return false;
     }
 
+    std::lock_guard<std::recursive_mutex> lock(send_mutex_);
+
     if (use_pcm_base64_ && packet->format == AudioPayloadFormat::kAudioPayloadFormatPcm16) {
         // Server expects raw base64 text (no JSON envelope) on $default route.
         size_t encoded_len = 0;
@@ -87,6 +89,8 @@ bool WebsocketProtocol::SendText(const std::string& text) {
         return false;
     }
 
+    std::lock_guard<std::recursive_mutex> lock(send_mutex_);
+
     if (!websocket_->Send(text)) {
         ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -96,6 +100,37 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool WebsocketProtocol::SendTextFragment(const char* data, size_t length, bool last) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
+
+    // Each fragment goes out as its own frame; the first one is a text frame and
+    // the following ones are continuation frames, closed by the frame with FIN set
+    if (!fragment_lock_.owns_lock()) {
+        fragment_lock_.lock();
+    }
+    if (!websocket_->Send(data, length, false, last)) {
+        ESP_LOGE(TAG, "Failed to send text fragment (%u bytes)", length);
+        fragment_lock_.unlock();
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    if (last) {
+        fragment_lock_.unlock();
+    }
+    return true;
+}
+
+void WebsocketProtocol::AbortTextFragments() {
+    if (fragment_lock_.owns_lock()) {
+        // The peer cannot recover from an unfinished fragmented message
+        ESP_LOGE(TAG, "Text message aborted after its first fragment");
+        fragment_lock_.unlock();
+        SetError(Lang::Strings::SERVER_ERROR);
+    }
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
     return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
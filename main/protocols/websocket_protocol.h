@@ -5,6 +5,7 @@
 #include "protocol.h"
 
 #include <web_socket.h>
+#include <mutex>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
@@ -26,9 +27,15 @@ private:
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
     bool use_pcm_base64_ = false;
+    // Held from the first fragment of a text message through its FIN frame, so no
+    // audio or text frame is sent between a text frame and its continuation frames
+    std::recursive_mutex send_mutex_;
+    std::unique_lock<std::recursive_mutex> fragment_lock_{send_mutex_, std::defer_lock};
 
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendTextFragment(const char* data, size_t length, bool last) override;
+    void AbortTextFragments() override;
     std::string GetHelloMessage();
 };
 
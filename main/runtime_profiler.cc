@@ -0,0 +1,213 @@
+#include "runtime_profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cJSON.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_console.h>
+#include <spi_flash_mmap.h>
+
+#define TAG "RuntimeProfiler"
+
+void RuntimeProfiler::Start(int interval_ms) {
+    if (task_handle_ != nullptr) {
+        return;
+    }
+    interval_ms_ = interval_ms;
+
+    // The history lives in PSRAM when there is some, it is only read on demand
+    samples_ = (Sample*)heap_caps_calloc(kHistorySize, sizeof(Sample), MALLOC_CAP_SPIRAM);
+    if (samples_ == nullptr) {
+        samples_ = (Sample*)heap_caps_calloc(kHistorySize, sizeof(Sample), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (samples_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for the sample history", kHistorySize * sizeof(Sample));
+        return;
+    }
+
+    xTaskCreate([](void* arg) {
+        static_cast<RuntimeProfiler*>(arg)->SamplerTask();
+    }, "profiler", 3072, this, 1, &task_handle_);
+
+    RegisterConsoleCommand();
+    ESP_LOGI(TAG, "Sampling every %d ms, %d samples kept", interval_ms_, kHistorySize);
+}
+
+void RuntimeProfiler::SamplerTask() {
+    TickType_t last_wake_time = xTaskGetTickCount();
+    while (true) {
+        TakeSample();
+        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(interval_ms_));
+    }
+}
+
+int RuntimeProfiler::FindSlot(const TaskStatus_t& status) {
+    int free_index = -1;
+    for (int i = 0; i < kMaxTasks; i++) {
+        auto& slot = slots_[i];
+        if (slot.handle == status.xHandle && strncmp(slot.name, status.pcTaskName, sizeof(slot.name)) == 0) {
+            return i;
+        }
+        // A slot is reused only after every sample that refers to it has left the ring
+        if (free_index < 0 && (slot.handle == nullptr || slot.last_seen + kHistorySize < sequence_)) {
+            free_index = i;
+        }
+    }
+    if (free_index >= 0) {
+        auto& slot = slots_[free_index];
+        slot.handle = status.xHandle;
+        strncpy(slot.name, status.pcTaskName, sizeof(slot.name) - 1);
+        slot.name[sizeof(slot.name) - 1] = '\0';
+        slot.last_run_time = status.ulRunTimeCounter;
+        slot.last_seen = sequence_;
+    }
+    return free_index;
+}
+
+void RuntimeProfiler::TakeSample() {
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 4;
+    if (status_.size() < capacity) {
+        status_.resize(capacity);
+    }
+    configRUN_TIME_COUNTER_TYPE total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(status_.data(), status_.size(), &total_run_time);
+    if (count == 0) {
+        return;
+    }
+    // The run time counter counts per core, so 100% means all cores are busy
+    uint64_t elapsed = (uint64_t)(total_run_time - last_total_run_time_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    last_total_run_time_ = total_run_time;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Sample& sample = samples_[sequence_ % kHistorySize];
+    memset(&sample, 0, sizeof(sample));
+    sample.time_ms = esp_timer_get_time() / 1000;
+    sample.sram_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    sample.sram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    sample.psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    sample.psram_largest = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+    sample.mmap_free_pages = spi_flash_mmap_get_free_pages(SPI_FLASH_MMAP_DATA);
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        const auto& status = status_[i];
+        int index = FindSlot(status);
+        if (index < 0) {
+            continue;
+        }
+        auto& slot = slots_[index];
+        uint32_t task_elapsed = status.ulRunTimeCounter - slot.last_run_time;
+        slot.last_run_time = status.ulRunTimeCounter;
+        slot.last_seen = sequence_;
+
+        auto& task = sample.tasks[index];
+        task.present = true;
+        task.cpu_percent = elapsed > 0 ? std::min<uint64_t>(100, task_elapsed * 100ULL / elapsed) : 0;
+        task.stack_free = std::min<uint32_t>(status.usStackHighWaterMark, UINT16_MAX);
+    }
+
+    // The first sample only sets the reference run time counters
+    if (!primed_) {
+        primed_ = true;
+        return;
+    }
+    sequence_++;
+}
+
+std::string RuntimeProfiler::GetTimeSeriesJson(int max_samples) {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "interval_ms", interval_ms_);
+    cJSON* samples = cJSON_CreateArray();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint32_t count = std::min<uint32_t>(std::max(max_samples, 0), std::min<uint32_t>(sequence_, kHistorySize));
+        for (uint32_t sequence = sequence_ - count; sequence < sequence_; sequence++) {
+            const Sample& sample = samples_[sequence % kHistorySize];
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddNumberToObject(item, "time_ms", sample.time_ms);
+            cJSON_AddNumberToObject(item, "sram_free", sample.sram_free);
+            cJSON_AddNumberToObject(item, "sram_largest", sample.sram_largest);
+            cJSON_AddNumberToObject(item, "psram_free", sample.psram_free);
+            cJSON_AddNumberToObject(item, "psram_largest", sample.psram_largest);
+            cJSON_AddNumberToObject(item, "mmap_free_pages", sample.mmap_free_pages);
+            cJSON* tasks = cJSON_CreateArray();
+            for (int i = 0; i < kMaxTasks; i++) {
+                if (!sample.tasks[i].present) {
+                    continue;
+                }
+                cJSON* task = cJSON_CreateArray();
+                cJSON_AddItemToArray(task, cJSON_CreateString(slots_[i].name));
+                cJSON_AddItemToArray(task, cJSON_CreateNumber(sample.tasks[i].cpu_percent));
+                cJSON_AddItemToArray(task, cJSON_CreateNumber(sample.tasks[i].stack_free));
+                cJSON_AddItemToArray(tasks, task);
+            }
+            cJSON_AddItemToObject(item, "tasks", tasks);
+            cJSON_AddItemToArray(samples, item);
+        }
+    }
+    cJSON_AddItemToObject(root, "samples", samples);
+
+    char* json_str = cJSON_PrintUnformatted(root);
+    std::string result(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return result;
+}
+
+void RuntimeProfiler::PrintTimeSeries(int max_samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t count = std::min<uint32_t>(std::max(max_samples, 0), std::min<uint32_t>(sequence_, kHistorySize));
+    for (uint32_t sequence = sequence_ - count; sequence < sequence_; sequence++) {
+        const Sample& sample = samples_[sequence % kHistorySize];
+        printf("[%lu ms] sram %lu (block %lu) psram %lu (block %lu) mmap free pages %u\n",
+            sample.time_ms, sample.sram_free, sample.sram_largest, sample.psram_free, sample.psram_largest,
+            sample.mmap_free_pages);
+        printf("| Task             |  CPU | Stack free\n");
+        for (int i = 0; i < kMaxTasks; i++) {
+            if (sample.tasks[i].present) {
+                printf("| %-16s | %3u%% | %6u\n", slots_[i].name, sample.tasks[i].cpu_percent, sample.tasks[i].stack_free);
+            }
+        }
+    }
+}
+
+void RuntimeProfiler::RegisterConsoleCommand() {
+    const esp_console_cmd_t cmd = {
+        .command = "profile",
+        .help = "Print the latest runtime profile samples",
+        .hint = "[samples]",
+        .func = [](int argc, char** argv) -> int {
+            int samples = argc > 1 ? atoi(argv[1]) : 1;
+            RuntimeProfiler::GetInstance().PrintTimeSeries(samples);
+            return 0;
+        },
+        .argtable = nullptr
+    };
+    esp_err_t ret = esp_console_cmd_register(&cmd);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to register console command: %s", esp_err_to_name(ret));
+        return;
+    }
+
+#ifndef CONFIG_BOARD_TYPE_SEEED_STUDIO_SENSECAP_WATCHER
+    // The SenseCAP Watcher starts its own REPL, which picks up the command
+    esp_console_repl_t* repl = nullptr;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "xiaozhi>";
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t hw_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ret = esp_console_new_repl_usb_serial_jtag(&hw_config, &repl_config, &repl);
+#else
+    esp_console_dev_uart_config_t hw_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ret = esp_console_new_repl_uart(&hw_config, &repl_config, &repl);
+#endif
+    if (ret == ESP_OK) {
+        ret = esp_console_start_repl(repl);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start console: %s", esp_err_to_name(ret));
+    }
+#endif
+}
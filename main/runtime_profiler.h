@@ -0,0 +1,81 @@
+#ifndef RUNTIME_PROFILER_H
+#define RUNTIME_PROFILER_H
+
+#include <string>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * Background sampler of per-task CPU share, stack high-water marks, heap and
+ * mmap usage. Samples are kept in a fixed ring buffer so load spikes around
+ * wake words or TTS bursts can be inspected afterwards, through the
+ * self.get_runtime_profile MCP tool or the `profile` console command.
+ */
+class RuntimeProfiler {
+public:
+    static constexpr int kMaxTasks = 24;
+    static constexpr int kHistorySize = 60;
+
+    static RuntimeProfiler& GetInstance() {
+        static RuntimeProfiler instance;
+        return instance;
+    }
+
+    void Start(int interval_ms = 1000);
+
+    /**
+     * The latest samples, oldest first:
+     * {"interval_ms":1000,"samples":[{"time_ms":..,"sram_free":..,"sram_largest":..,
+     *  "psram_free":..,"psram_largest":..,"mmap_free_pages":..,
+     *  "tasks":[["name",cpu_percent,stack_free_bytes],...]}]}
+     */
+    std::string GetTimeSeriesJson(int max_samples);
+    void PrintTimeSeries(int max_samples);
+
+private:
+    struct TaskSlot {
+        TaskHandle_t handle = nullptr;
+        char name[configMAX_TASK_NAME_LEN] = {};
+        configRUN_TIME_COUNTER_TYPE last_run_time = 0;
+        uint32_t last_seen = 0;  // Sequence of the last sample that contains the task
+    };
+
+    struct TaskSample {
+        bool present;
+        uint8_t cpu_percent;
+        uint16_t stack_free;
+    };
+
+    struct Sample {
+        uint32_t time_ms;
+        uint32_t sram_free;
+        uint32_t sram_largest;
+        uint32_t psram_free;
+        uint32_t psram_largest;
+        uint16_t mmap_free_pages;
+        TaskSample tasks[kMaxTasks];
+    };
+
+    std::mutex mutex_;
+    TaskHandle_t task_handle_ = nullptr;
+    int interval_ms_ = 1000;
+    Sample* samples_ = nullptr;
+    uint32_t sequence_ = 0;  // Number of samples taken so far
+    TaskSlot slots_[kMaxTasks];
+    std::vector<TaskStatus_t> status_;
+    configRUN_TIME_COUNTER_TYPE last_total_run_time_ = 0;
+    bool primed_ = false;
+
+    RuntimeProfiler() = default;
+
+    void SamplerTask();
+    void TakeSample();
+    int FindSlot(const TaskStatus_t& status);
+    void RegisterConsoleCommand();
+};
+
+#endif // RUNTIME_PROFILER_H
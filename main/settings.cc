@@ -1,88 +1,388 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
+#include <algorithm>
 
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+SettingsCache::SettingsCache() {
+    // NVS erases can stall for a long time, so the commit runs in its own task
+    // instead of delaying every other callback of the esp_timer task
+    xTaskCreate([](void* arg) {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            static_cast<SettingsCache*>(arg)->Flush();
+        }
+    }, "settings_commit", 4096, this, 1, &commit_task_);
+
+    esp_timer_create_args_t commit_timer_args = {
+        .callback = [](void* arg) {
+            xTaskNotifyGive(static_cast<SettingsCache*>(arg)->commit_task_);
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_commit",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&commit_timer_args, &commit_timer_));
+
+    // Pending writes must reach flash before esp_restart()
+    esp_register_shutdown_handler([]() {
+        SettingsCache::GetInstance().Flush();
+    });
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+SettingsCache::~SettingsCache() {
+    if (commit_timer_ != nullptr) {
+        esp_timer_stop(commit_timer_);
+        esp_timer_delete(commit_timer_);
+    }
+    if (commit_task_ != nullptr) {
+        vTaskDelete(commit_task_);
+    }
+}
+
+void SettingsCache::ScheduleCommit() {
+    // Called with mutex_ held; writes arriving before the timer fires are committed together
+    if (!commit_pending_) {
+        commit_pending_ = true;
+        esp_timer_start_once(commit_timer_, kCommitDelayMs * 1000);
+    }
+}
+
+SettingsCache::Entry* SettingsCache::Lookup(const std::string& ns, const std::string& key, EntryType type) {
+    auto& space = namespaces_[ns];
+    auto it = space.entries.find(key);
+    if (it != space.entries.end()) {
+        // An absent entry only says there is no value of the type it was probed with
+        if (it->second.exists || it->second.dirty || it->second.type == type || space.all_absent) {
+            return &it->second;
         }
-        nvs_close(nvs_handle_);
+        space.entries.erase(it);
     }
+
+    // First access of the key, load it from flash
+    Entry entry;
+    entry.type = type;
+    nvs_handle_t nvs_handle = 0;
+    if (!space.all_absent && nvs_open(ns.c_str(), NVS_READONLY, &nvs_handle) == ESP_OK) {
+        switch (type) {
+            case kEntryTypeString: {
+                size_t length = 0;
+                if (nvs_get_str(nvs_handle, key.c_str(), nullptr, &length) == ESP_OK) {
+                    entry.string_value.resize(length);
+                    if (nvs_get_str(nvs_handle, key.c_str(), entry.string_value.data(), &length) == ESP_OK) {
+                        while (!entry.string_value.empty() && entry.string_value.back() == '\0') {
+                            entry.string_value.pop_back();
+                        }
+                        entry.exists = true;
+                    }
+                }
+                break;
+            }
+            case kEntryTypeInt:
+                entry.exists = nvs_get_i32(nvs_handle, key.c_str(), &entry.int_value) == ESP_OK;
+                break;
+            case kEntryTypeBool: {
+                uint8_t value = 0;
+                entry.exists = nvs_get_u8(nvs_handle, key.c_str(), &value) == ESP_OK;
+                entry.int_value = value != 0;
+                break;
+            }
+        }
+        nvs_close(nvs_handle);
+    }
+    return &space.entries.emplace(key, std::move(entry)).first->second;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
+bool SettingsCache::Store(const std::string& ns, const std::string& key, Entry&& entry) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set_requests_++;
+        auto current = Lookup(ns, key, entry.type);
+        if (current->exists == entry.exists && (!entry.exists || (current->type == entry.type &&
+            current->int_value == entry.int_value && current->string_value == entry.string_value))) {
+            // Unchanged, nothing to write
+            return false;
+        }
+        entry.dirty = true;
+        *current = std::move(entry);
+        namespaces_[ns].dirty = true;
+        ScheduleCommit();
+    }
+    NotifyChanged(ns, key);
+    return true;
+}
+
+void SettingsCache::NotifyChanged(const std::string& ns, const std::string& key) {
+    std::vector<std::function<void(const std::string& key)>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& [callback_ns, callback] : callbacks_) {
+            if (callback_ns == ns) {
+                callbacks.push_back(callback);
+            }
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback(key);
+    }
+}
+
+void SettingsCache::OnChanged(const std::string& ns, std::function<void(const std::string& key)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_.emplace_back(ns, std::move(callback));
+}
+
+std::string SettingsCache::GetString(const std::string& ns, const std::string& key, const std::string& default_value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Lookup(ns, key, kEntryTypeString);
+    if (!entry->exists || entry->type != kEntryTypeString) {
         return default_value;
     }
+    return entry->string_value;
+}
+
+void SettingsCache::SetString(const std::string& ns, const std::string& key, const std::string& value) {
+    Entry entry;
+    entry.type = kEntryTypeString;
+    entry.exists = true;
+    entry.string_value = value;
+    Store(ns, key, std::move(entry));
+}
+
+int32_t SettingsCache::GetInt(const std::string& ns, const std::string& key, int32_t default_value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Lookup(ns, key, kEntryTypeInt);
+    if (!entry->exists || entry->type != kEntryTypeInt) {
+        return default_value;
+    }
+    return entry->int_value;
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
+void SettingsCache::SetInt(const std::string& ns, const std::string& key, int32_t value) {
+    Entry entry;
+    entry.type = kEntryTypeInt;
+    entry.exists = true;
+    entry.int_value = value;
+    Store(ns, key, std::move(entry));
+}
+
+bool SettingsCache::GetBool(const std::string& ns, const std::string& key, bool default_value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Lookup(ns, key, kEntryTypeBool);
+    if (!entry->exists || entry->type != kEntryTypeBool) {
         return default_value;
     }
+    return entry->int_value != 0;
+}
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+void SettingsCache::SetBool(const std::string& ns, const std::string& key, bool value) {
+    Entry entry;
+    entry.type = kEntryTypeBool;
+    entry.exists = true;
+    entry.int_value = value ? 1 : 0;
+    Store(ns, key, std::move(entry));
+}
+
+void SettingsCache::EraseKey(const std::string& ns, const std::string& key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set_requests_++;
+        auto& space = namespaces_[ns];
+        auto it = space.entries.find(key);
+        if (it != space.entries.end() && !it->second.exists && (it->second.dirty || space.all_absent)) {
+            return;
+        }
+        if (it == space.entries.end() && space.all_absent) {
+            return;
+        }
+        // The stored type is unknown when the key was never read, so erase it unconditionally
+        Entry entry;
+        entry.dirty = true;
+        space.entries[key] = std::move(entry);
+        space.dirty = true;
+        ScheduleCommit();
     }
-    return value;
+    NotifyChanged(ns, key);
+}
+
+void SettingsCache::EraseAll(const std::string& ns) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        set_requests_++;
+        auto& space = namespaces_[ns];
+        space.entries.clear();
+        space.all_absent = true;
+        space.erase_pending = true;
+        space.dirty = true;
+        ScheduleCommit();
+    }
+    // An empty key means every key of the namespace
+    NotifyChanged(ns, "");
+}
+
+void SettingsCache::Flush() {
+    struct PendingNamespace {
+        std::string ns;
+        bool erase_all;
+        std::vector<std::pair<std::string, Entry>> entries;
+    };
+
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::vector<PendingNamespace> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (commit_pending_) {
+            esp_timer_stop(commit_timer_);
+            commit_pending_ = false;
+        }
+        for (auto& [ns, space] : namespaces_) {
+            if (!space.dirty) {
+                continue;
+            }
+            PendingNamespace item{ns, space.erase_pending, {}};
+            for (auto& [key, entry] : space.entries) {
+                if (entry.dirty) {
+                    item.entries.emplace_back(key, entry);
+                    entry.dirty = false;
+                }
+            }
+            space.erase_pending = false;
+            space.dirty = false;
+            pending.push_back(std::move(item));
+        }
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    // Flash is written without holding the cache lock so readers are not blocked
+    size_t committed_keys = 0;
+    for (auto& item : pending) {
+        // Keys whose write failed are marked dirty again, all of them if the commit failed
+        std::vector<std::string> failed_keys;
+        bool commit_failed = false;
+        nvs_handle_t nvs_handle = 0;
+        esp_err_t ret = nvs_open(item.ns.c_str(), NVS_READWRITE, &nvs_handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", item.ns.c_str(), esp_err_to_name(ret));
+            RestoreDirty(item.ns, item.erase_all, item.entries, failed_keys, true);
+            continue;
+        }
+        if (item.erase_all) {
+            ret = nvs_erase_all(nvs_handle);
+            flash_writes_++;
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase namespace %s: %s", item.ns.c_str(), esp_err_to_name(ret));
+                commit_failed = true;
+            }
+        }
+        for (auto& [key, entry] : item.entries) {
+            if (!entry.exists) {
+                ret = nvs_erase_key(nvs_handle, key.c_str());
+                if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                    ret = ESP_OK;
+                }
+            } else if (entry.type == kEntryTypeString) {
+                ret = nvs_set_str(nvs_handle, key.c_str(), entry.string_value.c_str());
+            } else if (entry.type == kEntryTypeInt) {
+                ret = nvs_set_i32(nvs_handle, key.c_str(), entry.int_value);
+            } else {
+                ret = nvs_set_u8(nvs_handle, key.c_str(), entry.int_value ? 1 : 0);
+            }
+            flash_writes_++;
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", item.ns.c_str(), key.c_str(), esp_err_to_name(ret));
+                failed_keys.push_back(key);
+            }
+        }
+        ret = nvs_commit(nvs_handle);
+        flash_commits_++;
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", item.ns.c_str(), esp_err_to_name(ret));
+            commit_failed = true;
+        }
+        nvs_close(nvs_handle);
+        if (commit_failed || !failed_keys.empty()) {
+            RestoreDirty(item.ns, item.erase_all, item.entries, failed_keys, commit_failed);
+        }
+        committed_keys += item.entries.size() - (commit_failed ? item.entries.size() : failed_keys.size());
+    }
+    ESP_LOGI(TAG, "Committed %u keys (set requests %lu, flash writes %lu, commits %lu)",
+        committed_keys, set_requests_, flash_writes_, flash_commits_);
+}
+
+void SettingsCache::RestoreDirty(const std::string& ns, bool erase_all,
+    const std::vector<std::pair<std::string, Entry>>& entries, const std::vector<std::string>& failed_keys, bool all_failed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& space = namespaces_[ns];
+    if (all_failed && erase_all) {
+        space.erase_pending = true;
+    }
+    for (auto& [key, entry] : entries) {
+        if (!all_failed && std::find(failed_keys.begin(), failed_keys.end(), key) == failed_keys.end()) {
+            continue;
+        }
+        // Entries written or erased again since the snapshot are already dirty or gone
+        auto it = space.entries.find(key);
+        if (it != space.entries.end()) {
+            it->second.dirty = true;
+        }
+    }
+    space.dirty = true;
+    ScheduleCommit();
+}
+
+void SettingsCache::Discard() {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (commit_pending_) {
+        esp_timer_stop(commit_timer_);
+        commit_pending_ = false;
+    }
+    namespaces_.clear();
+}
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+Settings::~Settings() {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    return SettingsCache::GetInstance().GetString(ns_, key, default_value);
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetString(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    return SettingsCache::GetInstance().GetInt(ns_, key, default_value);
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetInt(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    return SettingsCache::GetInstance().GetBool(ns_, key, default_value);
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsCache::GetInstance().SetBool(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +390,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().EraseKey(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +398,12 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Commit() {
+    SettingsCache::GetInstance().Flush();
+}
@@ -2,7 +2,94 @@
 #define SETTINGS_H
 
 #include <string>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <functional>
 #include <nvs_flash.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/**
+ * Process-wide write-back cache in front of NVS.
+ * Values are loaded from flash once and then served from RAM. Writes only mark
+ * the entry dirty; dirty entries are committed together by the commit task after
+ * kCommitDelayMs, before a restart, or when Flush() is called. Entries that fail
+ * to reach flash stay dirty and are retried with the next commit.
+ */
+class SettingsCache {
+public:
+    static constexpr int kCommitDelayMs = 2000;
+
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    std::string GetString(const std::string& ns, const std::string& key, const std::string& default_value);
+    void SetString(const std::string& ns, const std::string& key, const std::string& value);
+    int32_t GetInt(const std::string& ns, const std::string& key, int32_t default_value);
+    void SetInt(const std::string& ns, const std::string& key, int32_t value);
+    bool GetBool(const std::string& ns, const std::string& key, bool default_value);
+    void SetBool(const std::string& ns, const std::string& key, bool value);
+    void EraseKey(const std::string& ns, const std::string& key);
+    void EraseAll(const std::string& ns);
+
+    // Commit all dirty entries to NVS now
+    void Flush();
+    // Drop the cache without writing it back, e.g. before the NVS partition is erased
+    void Discard();
+    // Called with the key after a value in the namespace changes (from the writing task)
+    void OnChanged(const std::string& ns, std::function<void(const std::string& key)> callback);
+
+    inline uint32_t set_requests() const { return set_requests_; }
+    inline uint32_t flash_writes() const { return flash_writes_; }
+    inline uint32_t flash_commits() const { return flash_commits_; }
+
+private:
+    enum EntryType : uint8_t {
+        kEntryTypeString,
+        kEntryTypeInt,
+        kEntryTypeBool,
+    };
+
+    struct Entry {
+        EntryType type = kEntryTypeInt;
+        bool exists = false;    // false if the key is known to be absent
+        bool dirty = false;
+        int32_t int_value = 0;  // Also holds bool values
+        std::string string_value;
+    };
+
+    struct Namespace {
+        std::map<std::string, Entry> entries;
+        bool all_absent = false;     // Erased, so keys not in entries need no flash lookup
+        bool erase_pending = false;  // nvs_erase_all not committed yet
+        bool dirty = false;
+    };
+
+    std::mutex mutex_;
+    std::mutex flush_mutex_;
+    std::map<std::string, Namespace> namespaces_;
+    std::vector<std::pair<std::string, std::function<void(const std::string& key)>>> callbacks_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    TaskHandle_t commit_task_ = nullptr;
+    bool commit_pending_ = false;
+    uint32_t set_requests_ = 0;
+    uint32_t flash_writes_ = 0;
+    uint32_t flash_commits_ = 0;
+
+    SettingsCache();
+    ~SettingsCache();
+
+    Entry* Lookup(const std::string& ns, const std::string& key, EntryType type);
+    bool Store(const std::string& ns, const std::string& key, Entry&& entry);
+    void ScheduleCommit();
+    void RestoreDirty(const std::string& ns, bool erase_all, const std::vector<std::pair<std::string, Entry>>& entries,
+        const std::vector<std::string>& failed_keys, bool all_failed);
+    void NotifyChanged(const std::string& ns, const std::string& key);
+};
 
 class Settings {
 public:
@@ -17,12 +104,12 @@ public:
     void SetBool(const std::string& key, bool value);
     void EraseKey(const std::string& key);
     void EraseAll();
+    // Commit the cached writes to flash now, for values that must survive a crash
+    void Commit();
 
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
@@ -0,0 +1,120 @@
+#include "startup_scheduler.h"
+#include "boot_timeline.h"
+
+#include <cstring>
+#include <esp_log.h>
+#include <freertos/task.h>
+
+#define TAG "StartupScheduler"
+
+StartupScheduler::StartupScheduler() {
+    event_group_ = xEventGroupCreate();
+}
+
+StartupScheduler::~StartupScheduler() {
+    vEventGroupDelete(event_group_);
+}
+
+void StartupScheduler::Add(const char* name, std::initializer_list<const char*> dependencies, std::function<void()> job,
+    uint32_t stack_size, bool inline_job) {
+    if (jobs_.size() == kMaxJobs) {
+        ESP_LOGE(TAG, "Too many startup jobs, %s runs inline", name);
+        inline_job = true;
+    }
+    jobs_.push_back(Job{name, dependencies, std::move(job), stack_size, inline_job, false, false});
+}
+
+bool StartupScheduler::IsDone(const char* name) const {
+    for (const auto& job : jobs_) {
+        if (strcmp(job.name, name) == 0) {
+            return job.done;
+        }
+    }
+    // Unknown dependencies are treated as satisfied
+    ESP_LOGW(TAG, "Unknown startup job: %s", name);
+    return true;
+}
+
+bool StartupScheduler::IsReady(const Job& job) const {
+    for (auto dependency : job.dependencies) {
+        if (!IsDone(dependency)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StartupScheduler::Start(int index) {
+    auto& job = jobs_[index];
+    job.started = true;
+    if (job.inline_job || index >= kMaxJobs) {
+        BootTimeline::GetInstance().Begin(job.name);
+        job.function();
+        BootTimeline::GetInstance().End(job.name);
+        job.done = true;
+        return;
+    }
+
+    struct TaskArgs {
+        StartupScheduler* scheduler;
+        int index;
+    };
+    auto args = new TaskArgs{this, index};
+    auto ret = xTaskCreate([](void* arg) {
+        auto args = static_cast<TaskArgs*>(arg);
+        auto& job = args->scheduler->jobs_[args->index];
+        BootTimeline::GetInstance().Begin(job.name);
+        job.function();
+        BootTimeline::GetInstance().End(job.name);
+        xEventGroupSetBits(args->scheduler->event_group_, BIT0 << args->index);
+        delete args;
+        vTaskDelete(NULL);
+    }, job.name, job.stack_size, args, uxTaskPriorityGet(NULL), nullptr);
+    if (ret != pdPASS) {
+        ESP_LOGW(TAG, "Failed to create task for %s, running it inline", job.name);
+        delete args;
+        job.inline_job = true;
+        Start(index);
+    }
+}
+
+void StartupScheduler::Run() {
+    size_t done_count = 0;
+    while (done_count < jobs_.size()) {
+        // Start every job whose dependencies are done; inline jobs may unblock others
+        bool progressed = true;
+        while (progressed) {
+            progressed = false;
+            for (int i = 0; i < (int)jobs_.size(); i++) {
+                if (!jobs_[i].started && IsReady(jobs_[i])) {
+                    Start(i);
+                    if (jobs_[i].done) {
+                        done_count++;
+                        progressed = true;
+                    }
+                }
+            }
+        }
+
+        EventBits_t running = 0;
+        for (int i = 0; i < (int)jobs_.size() && i < kMaxJobs; i++) {
+            if (jobs_[i].started && !jobs_[i].done) {
+                running |= BIT0 << i;
+            }
+        }
+        if (running == 0) {
+            if (done_count < jobs_.size()) {
+                ESP_LOGE(TAG, "Startup jobs have circular dependencies, %u not run", jobs_.size() - done_count);
+            }
+            break;
+        }
+
+        EventBits_t bits = xEventGroupWaitBits(event_group_, running, pdTRUE, pdFALSE, portMAX_DELAY);
+        for (int i = 0; i < (int)jobs_.size() && i < kMaxJobs; i++) {
+            if (bits & running & (BIT0 << i)) {
+                jobs_[i].done = true;
+                done_count++;
+            }
+        }
+    }
+}
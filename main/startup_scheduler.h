@@ -0,0 +1,49 @@
+#ifndef STARTUP_SCHEDULER_H
+#define STARTUP_SCHEDULER_H
+
+#include <vector>
+#include <functional>
+#include <initializer_list>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+/**
+ * Runs startup jobs as soon as the jobs they depend on are done.
+ * Independent jobs run concurrently in their own tasks, not pinned to a core,
+ * so both cores are used; each job is recorded in the BootTimeline.
+ * Run() returns when every job has finished.
+ */
+class StartupScheduler {
+public:
+    static constexpr int kMaxJobs = 24;
+
+    StartupScheduler();
+    ~StartupScheduler();
+
+    // Job names must be string literals. inline_job runs the job in the task calling Run().
+    void Add(const char* name, std::initializer_list<const char*> dependencies, std::function<void()> job,
+        uint32_t stack_size = 4096, bool inline_job = false);
+    void Run();
+
+private:
+    struct Job {
+        const char* name;
+        std::vector<const char*> dependencies;
+        std::function<void()> function;
+        uint32_t stack_size;
+        bool inline_job;
+        bool started;
+        bool done;
+    };
+
+    std::vector<Job> jobs_;
+    EventGroupHandle_t event_group_ = nullptr;
+
+    bool IsDone(const char* name) const;
+    bool IsReady(const Job& job) const;
+    void Start(int index);
+};
+
+#endif // STARTUP_SCHEDULER_H
@@ -14,7 +14,6 @@ public:
     static std::string GetMacAddress();
     static std::string GetChipModelName();
     static std::string GetUserAgent();
-    static esp_err_t PrintTaskCpuUsage(TickType_t xTicksToWait);
     static void PrintTaskList();
     static void PrintHeapStats();
 };
@@ -11,6 +11,7 @@ Usage:
 """
 
 import argparse
+import hashlib
 import io
 import os
 import shutil
@@ -339,23 +340,92 @@ def compute_checksum(data):
     return checksum
 
 
+def lz4_compress_block(data):
+    """
+    Compress data as a single LZ4 block (no frame header). Uses the lz4 package when it
+    is installed, otherwise a greedy matcher that produces valid, if larger, blocks.
+    """
+    try:
+        import lz4.block
+        return lz4.block.compress(bytes(data), mode='high_compression', store_size=False)
+    except ImportError:
+        pass
+
+    out = bytearray()
+
+    def write_length(length):
+        while length >= 255:
+            out.append(255)
+            length -= 255
+        out.append(length)
+
+    def write_sequence(literals, offset=0, match_length=0):
+        token_literals = min(len(literals), 15)
+        token_match = min(match_length - 4, 15) if match_length else 0
+        out.append((token_literals << 4) | token_match)
+        if len(literals) >= 15:
+            write_length(len(literals) - 15)
+        out.extend(literals)
+        if match_length:
+            out.extend(offset.to_bytes(2, byteorder='little'))
+            if match_length - 4 >= 15:
+                write_length(match_length - 4 - 15)
+
+    # The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+    size = len(data)
+    match_limit = size - 12
+    positions = {}
+    anchor = 0
+    i = 0
+    while i < match_limit:
+        key = data[i:i + 4]
+        candidate = positions.get(key)
+        positions[key] = i
+        if candidate is None or i - candidate > 65535:
+            i += 1
+            continue
+        match_length = 4
+        max_length = size - 5 - i
+        while match_length < max_length and data[candidate + match_length] == data[i + match_length]:
+            match_length += 1
+        write_sequence(data[anchor:i], i - candidate, match_length)
+        i += match_length
+        anchor = i
+    write_sequence(data[anchor:])
+    return bytes(out)
+
+
 def sort_key(filename):
     basename, extension = os.path.splitext(filename)
     return extension, basename
 
 
-def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32):
+MMU_PAGE_SIZE = 64 * 1024
+
+
+def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32, compress=False, access_order=None):
     """
-    Simplified version of pack_assets that handles basic file packing
+    Simplified version of pack_assets that handles basic file packing.
+    With compress, files that shrink by at least 10% are stored LZ4 compressed with a "ZL" magic
+    and their decompressed size; the firmware decompresses them into PSRAM on first access.
+
+    The firmware maps the partition up to the first file of 64 KB or more at mount and maps
+    larger files when they are first used. So small files are laid out first, index.json and
+    then the files listed in access_order (as logged by the firmware in "Assets used: ..."),
+    followed by the large files, each aligned to a 64 KB MMU page, with srmodels.bin last.
     """
     merged_data = bytearray()
     file_info_list = []
     skip_files = ['config.json']
+    # srmodels.bin is loaded in place by esp-sr, and is too large to keep a decompressed copy of
+    stored_files = ['srmodels.bin']
+    total_input_size = 0
 
     # Ensure output directory exists
     os.makedirs(os.path.dirname(out_file), exist_ok=True)
     os.makedirs(include_path, exist_ok=True)
 
+    files = []
     file_list = sorted(os.listdir(target_path), key=sort_key)
     for filename in file_list:
         if filename in skip_files:
@@ -366,25 +436,65 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
             continue
             
         file_name = os.path.basename(file_path)
-        file_size = os.path.getsize(file_path)
-
-        file_info_list.append((file_name, len(merged_data), file_size, 0, 0))
-        # Add 0x5A5A prefix to merged_data
-        merged_data.extend(b'\x5A' * 2)
-
         with open(file_path, 'rb') as bin_file:
             bin_data = bin_file.read()
-
+        total_input_size += len(bin_data)
+
+        magic = b'\x5A' * 2
+        if compress and file_name not in stored_files:
+            compressed = len(bin_data).to_bytes(4, byteorder='little') + lz4_compress_block(bin_data)
+            if len(compressed) <= len(bin_data) * 0.9:
+                magic = b'ZL'
+                bin_data = compressed
+        files.append((file_name, magic, bin_data))
+
+    access_rank = {name: rank for rank, name in enumerate(access_order or [])}
+
+    def layout_key(file):
+        file_name, _, bin_data = file
+        if file_name in stored_files:
+            group = 4
+        elif len(bin_data) >= MMU_PAGE_SIZE:
+            group = 3
+        elif file_name == 'index.json':
+            group = 0
+        elif file_name in access_rank:
+            group = 1
+        else:
+            group = 2
+        return group, access_rank.get(file_name, len(access_rank))
+
+    # sorted() is stable, so files of the same group and rank keep their (extension, name) order
+    files = sorted(files, key=layout_key)
+    data_start = 12 + len(files) * (max_name_len + 12)
+    for file_name, magic, bin_data in files:
+        if len(bin_data) >= MMU_PAGE_SIZE:
+            # Assumes the partition starts on an MMU page, as the default partition tables do
+            padding = -(data_start + len(merged_data)) % MMU_PAGE_SIZE
+            merged_data.extend(b'\xFF' * padding)
+
+        file_info_list.append((file_name, len(merged_data), len(bin_data), 0, 0))
+        # Add 0x5A5A prefix to merged_data (ZL for compressed files)
+        merged_data.extend(magic)
         merged_data.extend(bin_data)
 
     total_files = len(file_info_list)
 
+    # The firmware binary searches the table in place, so it is sorted by the stored name bytes.
+    # The file data keeps its own order, the table entries point to it by offset.
+    def table_name(file_name):
+        return file_name.encode('utf-8')[:max_name_len]
+
+    file_info_list.sort(key=lambda info: table_name(info[0]))
+    for previous, current in zip(file_info_list, file_info_list[1:]):
+        if table_name(previous[0]) == table_name(current[0]):
+            raise ValueError(f'Asset names "{previous[0]}" and "{current[0]}" are the same in the first {max_name_len} bytes')
+
     mmap_table = bytearray()
     for file_name, offset, file_size, width, height in file_info_list:
-        if len(file_name) > max_name_len:
+        if len(file_name.encode('utf-8')) > max_name_len:
             print(f'Warning: "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
-        fixed_name = file_name.ljust(max_name_len, '\0')[:max_name_len]
-        mmap_table.extend(fixed_name.encode('utf-8'))
+        mmap_table.extend(table_name(file_name).ljust(max_name_len, b'\0'))
         mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
         mmap_table.extend(offset.to_bytes(4, byteorder='little'))
         mmap_table.extend(width.to_bytes(2, byteorder='little'))
@@ -399,6 +509,21 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
 
+    # The manifest lets devices fetch only the files that changed, with range requests into the image
+    data_start = len(header_data) + len(combined_data_length) + len(mmap_table)
+    manifest_files = []
+    for file_name, offset, file_size, _, _ in file_info_list:
+        start = data_start + offset
+        stored = final_data[start:start + 2 + file_size]
+        manifest_files.append({
+            'name': file_name,
+            'offset': start,
+            'size': len(stored),
+            'sha256': hashlib.sha256(stored).hexdigest()
+        })
+    with open(out_file + '.manifest.json', 'w') as manifest:
+        json.dump({'version': 1, 'files': manifest_files}, manifest, indent=2)
+
     # Generate header file
     current_year = datetime.now().year
     asset_name = os.path.basename(assets_path)
@@ -426,6 +551,8 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
         output_header.write('};\n')
 
     print(f'All files have been merged into {os.path.basename(out_file)}')
+    if compress:
+        print(f'Compressed {total_input_size} bytes of files into {len(merged_data)} bytes')
 
 
 # =============================================================================
@@ -698,7 +825,7 @@ def get_emoji_collection_path(default_emoji_collection, xiaozhi_fonts_path):
         return None
 
 
-def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None):
+def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None, compress=False, access_order=None):
     """
     Build assets using integrated functions (no external dependencies)
     """
@@ -734,12 +861,14 @@ def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font
         # Use simplified packing function
         include_path = config_data['include_path']
         image_file = config_data['image_file']
-        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']))
+        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']), compress, access_order)
         
         # Copy final assets.bin to output location
         if os.path.exists(image_file):
             shutil.copy2(image_file, output_path)
+            shutil.copy2(image_file + '.manifest.json', output_path + '.manifest.json')
             print(f"Successfully generated assets.bin: {output_path}")
+            print(f"Delta update manifest: {output_path}.manifest.json (upload it next to assets.bin)")
             
             # Show size information
             total_size = os.path.getsize(output_path)
@@ -768,6 +897,8 @@ def main():
     parser.add_argument('--esp_sr_model_path', help='Path to ESP-SR model directory')
     parser.add_argument('--xiaozhi_fonts_path', help='Path to xiaozhi-fonts component directory')
     parser.add_argument('--extra_files', help='Path to extra files directory to be included in assets')
+    parser.add_argument('--compress', action='store_true', help='Store files LZ4 compressed when it makes them smaller')
+    parser.add_argument('--access_order', help='Comma separated asset names in the order the firmware uses them (from its "Assets used" log), laid out first')
     
     args = parser.parse_args()
     
@@ -870,7 +1001,8 @@ def main():
     
     # Build the assets
     success = build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, 
-                                     extra_files_path, args.output, multinet_model_info)
+                                     extra_files_path, args.output, multinet_model_info, args.compress,
+                                     args.access_order.split(',') if args.access_order else None)
     
     if not success:
         sys.exit(1)
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+"""
+Create a firmware delta patch for the delta OTA in main/ota.cc
+
+The patch rebuilds new.bin from the image running on the device (old.bin) with COPY
+commands for unchanged ranges, ADD commands (byte-wise differences, LZ4 compressed)
+for ranges that moved with a few changed bytes such as relocated addresses, and
+INSERT commands for new data. The server offers it as "delta_url" next to "url" in
+the firmware section of the check version response, to devices running old.bin.
+
+Usage:
+    ./firmware_delta.py <old.bin> <new.bin> --output <patch.bin>
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from build_default_assets import lz4_compress_block
+
+
+PATCH_MAGIC = 0x50465A58  # "XZFP"
+PATCH_VERSION = 1
+PATCH_CHUNK = 4096
+
+CMD_END = 0
+CMD_COPY = 1
+CMD_ADD = 2
+CMD_INSERT = 3
+
+BLOCK_SIZE = 16       # Length of the seeds looked up in the old image
+INDEX_STRIDE = 4      # Seeds are indexed every INDEX_STRIDE bytes of the old image
+MIN_COPY = 256       # Shorter exact runs inside a match go into ADD, where zero differences compress well
+MAX_DIVERGENCE = 64   # A match ends once it has this many more mismatches than matches
+
+
+def image_digest(image):
+    """The digest esp_partition_get_sha256 returns for an application partition"""
+    # esp_image_header_t.hash_appended
+    if len(image) > 24 + 32 and image[23] == 1:
+        digest = image[-32:]
+        if hashlib.sha256(image[:-32]).digest() != digest:
+            raise ValueError("the appended SHA-256 of the base image does not match")
+        return digest
+    return hashlib.sha256(image).digest()
+
+
+def stored_chunk(data):
+    compressed = lz4_compress_block(data)
+    if len(compressed) < len(data):
+        return struct.pack('<I', len(compressed)) + compressed
+    return struct.pack('<I', len(data)) + bytes(data)
+
+
+def find_regions(old, new):
+    """Yields (new_start, new_end, old_start) for every part of new that follows old"""
+    index = {}
+    for i in range(0, len(old) - BLOCK_SIZE + 1, INDEX_STRIDE):
+        index.setdefault(old[i:i + BLOCK_SIZE], i)
+
+    j = 0
+    region_end = 0
+    while j <= len(new) - BLOCK_SIZE:
+        src = index.get(new[j:j + BLOCK_SIZE])
+        if src is None:
+            j += 1
+            continue
+
+        # Extend backwards over bytes not covered yet
+        while j > region_end and src > 0 and old[src - 1] == new[j - 1]:
+            j -= 1
+            src -= 1
+
+        # Extend forwards while at least half of the bytes match
+        k = j
+        score = best_score = 0
+        best_end = j
+        while k < len(new) and src + (k - j) < len(old):
+            score += 1 if old[src + (k - j)] == new[k] else -1
+            if score > best_score:
+                best_score = score
+                best_end = k + 1
+            elif score < best_score - MAX_DIVERGENCE:
+                break
+            k += 1
+
+        yield j, best_end, src
+        j = region_end = best_end
+
+
+def encode_region(old, new, start, end, src, out, stats):
+    """COPY for long exact runs, ADD for the rest of a region"""
+    def add(a, b):
+        for chunk_start in range(a, b, PATCH_CHUNK):
+            chunk_end = min(b, chunk_start + PATCH_CHUNK)
+            offset = src + chunk_start - start
+            diff = bytes((new[i] - old[offset + i - chunk_start]) & 0xFF for i in range(chunk_start, chunk_end))
+            out.extend(struct.pack('<BII', CMD_ADD, offset, chunk_end - chunk_start) + stored_chunk(diff))
+            stats['add'] += chunk_end - chunk_start
+
+    pending = start
+    i = start
+    while i < end:
+        if old[src + i - start] != new[i]:
+            i += 1
+            continue
+        run_end = i
+        while run_end < end and old[src + run_end - start] == new[run_end]:
+            run_end += 1
+        if run_end - i >= MIN_COPY:
+            add(pending, i)
+            out += struct.pack('<BII', CMD_COPY, src + i - start, run_end - i)
+            stats['copy'] += run_end - i
+            pending = run_end
+        i = run_end
+    add(pending, end)
+
+
+def encode_insert(new, start, end, out, stats):
+    for chunk_start in range(start, end, PATCH_CHUNK):
+        chunk_end = min(end, chunk_start + PATCH_CHUNK)
+        out += struct.pack('<BI', CMD_INSERT, chunk_end - chunk_start) + stored_chunk(new[chunk_start:chunk_end])
+        stats['insert'] += chunk_end - chunk_start
+
+
+def create_patch(old, new):
+    out = bytearray(struct.pack('<III', PATCH_MAGIC, PATCH_VERSION, len(new)))
+    out += image_digest(old)
+    out += hashlib.sha256(new).digest()
+
+    stats = {'copy': 0, 'add': 0, 'insert': 0}
+    position = 0
+    for start, end, src in find_regions(old, new):
+        encode_insert(new, position, start, out, stats)
+        encode_region(old, new, start, end, src, out, stats)
+        position = end
+    encode_insert(new, position, len(new), out, stats)
+    out.append(CMD_END)
+    return bytes(out), stats
+
+
+def lz4_decompress_block(data, size):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        token = data[i]
+        i += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                byte = data[i]
+                i += 1
+                length += byte
+                if byte != 255:
+                    break
+        out += data[i:i + length]
+        i += length
+        if i == len(data):
+            break
+        offset = data[i] | (data[i + 1] << 8)
+        i += 2
+        length = token & 0x0F
+        if length == 15:
+            while True:
+                byte = data[i]
+                i += 1
+                length += byte
+                if byte != 255:
+                    break
+        for _ in range(length + 4):
+            out.append(out[-offset])
+    if len(out) != size:
+        raise ValueError("invalid LZ4 block")
+    return bytes(out)
+
+
+def verify_patch(old, new, patch):
+    """Rebuilds the new image the way the device does"""
+    magic, version, target_size = struct.unpack_from('<III', patch, 0)
+    assert magic == PATCH_MAGIC and version == PATCH_VERSION and target_size == len(new)
+    assert patch[12:44] == image_digest(old)
+    position = 76
+    out = bytearray()
+
+    def read_chunk(length):
+        nonlocal position
+        stored, = struct.unpack_from('<I', patch, position)
+        data = patch[position + 4:position + 4 + stored]
+        position += 4 + stored
+        return data if stored == length else lz4_decompress_block(data, length)
+
+    while True:
+        command = patch[position]
+        position += 1
+        if command == CMD_END:
+            break
+        if command == CMD_COPY:
+            src, length = struct.unpack_from('<II', patch, position)
+            position += 8
+            out += old[src:src + length]
+        elif command == CMD_ADD:
+            src, length = struct.unpack_from('<II', patch, position)
+            position += 8
+            diff = read_chunk(length)
+            out += bytes((old[src + i] + diff[i]) & 0xFF for i in range(length))
+        elif command == CMD_INSERT:
+            length, = struct.unpack_from('<I', patch, position)
+            position += 4
+            out += read_chunk(length)
+        else:
+            raise ValueError(f"unknown command {command}")
+    if bytes(out) != new or hashlib.sha256(out).digest() != patch[44:76]:
+        raise ValueError("the patch does not rebuild the new image")
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Create a firmware delta patch')
+    parser.add_argument('old', help='Firmware image running on the devices')
+    parser.add_argument('new', help='New firmware image')
+    parser.add_argument('--output', required=True, help='Output path for the patch')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+
+    patch, stats = create_patch(old, new)
+    verify_patch(old, new, patch)
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+
+    print(f"Patch: {len(patch)} bytes for a {len(new)} bytes image ({len(patch) * 100 / len(new):.1f}%)")
+    print(f"Copied {stats['copy']}, added {stats['add']}, inserted {stats['insert']} bytes")
+
+
+if __name__ == "__main__":
+    main()
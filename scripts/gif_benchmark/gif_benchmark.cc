@@ -0,0 +1,135 @@
+/*
+ * Host benchmark of the GIF decoding behind LvglGif, built and run by gif_benchmark.py.
+ * For each GIF it prints a tab separated line: name, width, height, frames per loop,
+ * frames per second decoded by gifdec, frames per second copied from GifFrameCache
+ * and the bytes the cache holds.
+ */
+#include "gifdec.h"
+#include "gif_frame_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+static bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+// Decodes and renders a frame the way LvglGif does, returning the rectangle it changed
+static bool DecodeFrame(gd_GIF* gif, uint16_t& x, uint16_t& y, uint16_t& w, uint16_t& h) {
+    uint16_t x1 = gif->fx, y1 = gif->fy;
+    uint16_t x2 = gif->fx + gif->fw, y2 = gif->fy + gif->fh;
+    if (gd_get_frame(gif) != 1) {
+        return false;
+    }
+    gd_render_frame(gif, gif->canvas);
+    if (gif->fw > 0 && gif->fh > 0) {
+        x1 = std::min(x1, gif->fx);
+        y1 = std::min(y1, gif->fy);
+        x2 = std::max<uint16_t>(x2, gif->fx + gif->fw);
+        y2 = std::max<uint16_t>(y2, gif->fy + gif->fh);
+    }
+    x = x1;
+    y = y1;
+    w = x2 - x1;
+    h = y2 - y1;
+    return true;
+}
+
+static double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static bool Benchmark(const char* path, int loops) {
+    std::vector<uint8_t> data;
+    if (!ReadFile(path, data)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return false;
+    }
+    gd_GIF* gif = gd_open_gif_data(data.data());
+    if (gif == nullptr) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    // Emoji loop endlessly
+    gif->loop_count = 0;
+
+    GifFrameCache cache(gif->width, gif->height, SIZE_MAX);
+    uint16_t x, y, w, h;
+    uint32_t first_frame_end = 0;
+    uint32_t frames = 0;
+    int loop = 0;
+    auto start = Clock::now();
+    while (loop < loops) {
+        if (!DecodeFrame(gif, x, y, w, h)) {
+            fprintf(stderr, "Failed to decode %s\n", path);
+            gd_close_gif(gif);
+            return false;
+        }
+        // Every loop reads the frames from the same data, so a loop starts where the first frame ended
+        if (frames++ == 0) {
+            first_frame_end = gif->f_rw_p;
+            continue;
+        }
+        bool loop_start = gif->f_rw_p == first_frame_end;
+        if (loop_start) {
+            loop++;
+        }
+        if (!cache.ready()) {
+            auto record_start = Clock::now();
+            cache.AddFrame(gif->canvas, x, y, w, h, gif->gce.delay, loop_start);
+            // Recording is not part of decoding
+            start += Clock::now() - record_start;
+        }
+    }
+    double decode_fps = frames / Seconds(start);
+
+    double cached_fps = 0;
+    if (cache.ready()) {
+        start = Clock::now();
+        for (uint32_t i = 0; i < frames; i++) {
+            cache.NextFrame(gif->canvas);
+        }
+        cached_fps = frames / Seconds(start);
+    }
+
+    std::string name = path;
+    name = name.substr(name.find_last_of('/') + 1);
+    printf("%s\t%u\t%u\t%zu\t%.1f\t%.1f\t%zu\n", name.c_str(), gif->width, gif->height, cache.frame_count(),
+        decode_fps, cached_fps, cache.used_bytes());
+    gd_close_gif(gif);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int loops = 20;
+    int first = 1;
+    if (argc > 2 && std::string(argv[1]) == "--loops") {
+        loops = std::max(2, atoi(argv[2]));
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Usage: %s [--loops <count>] <gif>...\n", argv[0]);
+        return 1;
+    }
+    bool ok = true;
+    for (int i = first; i < argc; i++) {
+        ok = Benchmark(argv[i], loops) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+Benchmark the GIF decoding of the emoji on the host
+
+Builds gif_benchmark.cc against main/display/lvgl_display/gif twice, with the stack
+based LZW decoder the firmware uses and with the table based one it replaced, then
+prints the frames per second of each decoder and of replaying the frames from
+GifFrameCache for every GIF. Host numbers are relative: compare the columns, not
+against the device.
+
+Usage:
+    ./gif_benchmark.py --emoji_collection <collection_name> [--xiaozhi_fonts_path <path>]
+    ./gif_benchmark.py <gif or directory>...
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+PROJECT_ROOT = os.path.dirname(os.path.dirname(SCRIPT_DIR))
+GIF_DIR = os.path.join(PROJECT_ROOT, "main", "display", "lvgl_display", "gif")
+
+sys.path.insert(0, os.path.dirname(SCRIPT_DIR))
+from build_default_assets import get_emoji_collection_path
+
+
+def build(output, defines):
+    includes = ["-I", os.path.join(SCRIPT_DIR, "shim"), "-I", GIF_DIR]
+    gifdec = output + "_gifdec.o"
+    subprocess.run([os.environ.get("CC", "gcc"), "-O2", "-c", os.path.join(GIF_DIR, "gifdec.c"), "-o", gifdec]
+                   + includes + defines, check=True)
+    subprocess.run([os.environ.get("CXX", "g++"), "-O2", "-std=gnu++17",
+                    os.path.join(GIF_DIR, "gif_frame_cache.cc"), os.path.join(SCRIPT_DIR, "gif_benchmark.cc"),
+                    gifdec, "-o", output] + includes + defines, check=True)
+
+
+def run(binary, gifs, loops):
+    result = subprocess.run([binary, "--loops", str(loops)] + gifs, check=False, stdout=subprocess.PIPE, text=True)
+    rows = {}
+    for line in result.stdout.splitlines():
+        name, width, height, frames, decode_fps, cached_fps, cache_bytes = line.split("\t")
+        rows[name] = (int(width), int(height), int(frames), float(decode_fps), float(cached_fps), int(cache_bytes))
+    return rows
+
+
+def find_gifs(paths):
+    gifs = []
+    for path in paths:
+        if os.path.isdir(path):
+            for root, _, files in os.walk(path):
+                gifs += [os.path.join(root, f) for f in sorted(files) if f.lower().endswith(".gif")]
+        else:
+            gifs.append(path)
+    return gifs
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark the GIF decoding of the emoji on the host')
+    parser.add_argument('paths', nargs='*', help='GIF files or directories')
+    parser.add_argument('--emoji_collection', help='Default emoji collection name (e.g., emojis_32)')
+    parser.add_argument('--xiaozhi_fonts_path', default=os.path.join(PROJECT_ROOT, "components", "xiaozhi-fonts"),
+                        help='Path to xiaozhi-fonts component directory')
+    parser.add_argument('--loops', type=int, default=20, help='Loops decoded per GIF')
+    args = parser.parse_args()
+
+    paths = list(args.paths)
+    if args.emoji_collection:
+        emoji_path = get_emoji_collection_path(args.emoji_collection, args.xiaozhi_fonts_path)
+        if emoji_path:
+            paths.append(emoji_path)
+    gifs = find_gifs(paths)
+    if not gifs:
+        print("No GIF found")
+        return 1
+
+    with tempfile.TemporaryDirectory() as build_dir:
+        stack_binary = os.path.join(build_dir, "gif_benchmark")
+        table_binary = os.path.join(build_dir, "gif_benchmark_table")
+        build(stack_binary, [])
+        build(table_binary, ["-DGIFDEC_TABLE_DECODER"])
+        stack = run(stack_binary, gifs, args.loops)
+        table = run(table_binary, gifs, args.loops)
+
+    print(f"{'GIF':<32} {'Size':>9} {'Frames':>6} {'Table fps':>10} {'Stack fps':>10} {'Cached fps':>11} {'Cache':>9}")
+    for name, (width, height, frames, decode_fps, cached_fps, cache_bytes) in stack.items():
+        table_fps = table[name][3] if name in table else 0
+        size = f"{width}x{height}"
+        cached = f"{cached_fps:.0f}" if cached_fps else "-"
+        print(f"{name:<32} {size:>9} {frames:>6} {table_fps:>10.0f} {decode_fps:>10.0f} {cached:>11} {cache_bytes / 1024:>7.1f}KB")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
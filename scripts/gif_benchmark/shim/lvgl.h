@@ -0,0 +1,45 @@
+/* The parts of LVGL gifdec.c uses, for building it on the host */
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define LV_GIF_CACHE_DECODE_DATA 0
+#define LV_USE_DRAW_SW_ASM 0
+#define LV_DRAW_SW_ASM_HELIUM 2
+
+typedef FILE* lv_fs_file_t;
+typedef int lv_fs_res_t;
+#define LV_FS_RES_OK 0
+#define LV_FS_MODE_RD 0
+#define LV_FS_SEEK_SET SEEK_SET
+#define LV_FS_SEEK_CUR SEEK_CUR
+
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t* file, const char* path, int mode) {
+    (void)mode;
+    *file = fopen(path, "rb");
+    return *file != NULL ? LV_FS_RES_OK : -1;
+}
+static inline lv_fs_res_t lv_fs_read(lv_fs_file_t* file, void* buf, uint32_t len, uint32_t* read) {
+    size_t n = fread(buf, 1, len, *file);
+    if (read != NULL) *read = n;
+    return LV_FS_RES_OK;
+}
+static inline lv_fs_res_t lv_fs_seek(lv_fs_file_t* file, uint32_t pos, int whence) {
+    fseek(*file, pos, whence);
+    return LV_FS_RES_OK;
+}
+static inline lv_fs_res_t lv_fs_tell(lv_fs_file_t* file, uint32_t* pos) {
+    *pos = ftell(*file);
+    return LV_FS_RES_OK;
+}
+static inline lv_fs_res_t lv_fs_close(lv_fs_file_t* file) {
+    fclose(*file);
+    return LV_FS_RES_OK;
+}
+
+#define lv_malloc malloc
+#define lv_realloc realloc
+#define lv_free free